@@ -0,0 +1,129 @@
+/** \file sigscan.c
+ *
+ * Benchmark for the signature scanning backends.
+ *
+ * Scans a synthetic buffer (biased towards the bytes that are common in
+ * executables) for a signature planted near its end, and reports the
+ * throughput of every backend supported by the current CPU, along with
+ * a naive byte-by-byte scan for reference.
+ *
+ * Run it with `meson test -C build --benchmark` or directly as `sigscan-bench [MiB]`.
+ */
+#include "src/lasr/scan/pattern.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SIGNATURE "89 5C 24 ?? 89 44 24 ?? 74 ?? 48 8D 15"
+#define BENCH_ROUNDS 5
+
+static const uint8_t common_bytes[] = { 0x00, 0x00, 0x00, 0xFF, 0x48, 0x8B, 0x89, 0xCC, 0x24, 0x0F };
+
+/**
+ * Fills a buffer with pseudo-random bytes, where a third of them are
+ * picked among the bytes common in executables.
+ *
+ * @param buffer The buffer to fill.
+ * @param size The size of the buffer.
+ */
+static void fill_buffer(uint8_t* buffer, size_t size)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < size; i++) {
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        uint8_t r = state >> 32;
+        buffer[i] = (r % 3 == 0) ? common_bytes[(state >> 8) % sizeof(common_bytes)] : (uint8_t)(state >> 16);
+    }
+}
+
+/**
+ * Returns the current monotonic time, in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * The scan performed before the anchored backends, testing every offset.
+ */
+static size_t find_naive(const ScanPattern* pattern, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i + pattern->length <= size; i++) {
+        if (scan_matchAt(pattern, data + i)) {
+            return i;
+        }
+    }
+    return SCAN_NOT_FOUND;
+}
+
+/**
+ * Prints the throughput of a scan function.
+ */
+static void report(const char* name, size_t (*find)(ScanBackend, const ScanPattern*, const uint8_t*, size_t), ScanBackend backend, const ScanPattern* pattern, const uint8_t* data, size_t size, size_t expected)
+{
+    double best = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double start = now();
+        size_t found = find(backend, pattern, data, size);
+        double elapsed = now() - start;
+        if (found != expected) {
+            printf("%-8s wrong result: %zu, expected %zu\n", name, found, expected);
+            exit(EXIT_FAILURE);
+        }
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    printf("%-8s %8.2f GB/s\n", name, (double)size / best / 1e9);
+}
+
+static size_t find_naive_backend(ScanBackend backend, const ScanPattern* pattern, const uint8_t* data, size_t size)
+{
+    return find_naive(pattern, data, size);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t mib = argc > 1 ? strtoul(argv[1], NULL, 10) : 256;
+    size_t size = mib * 1024 * 1024;
+    uint8_t* data = malloc(size);
+    if (!data) {
+        fprintf(stderr, "Failed to allocate %zu MiB\n", mib);
+        return EXIT_FAILURE;
+    }
+    fill_buffer(data, size);
+
+    ScanPattern pattern;
+    if (!scan_compilePattern(BENCH_SIGNATURE, &pattern)) {
+        fprintf(stderr, "Failed to compile the benchmark signature\n");
+        return EXIT_FAILURE;
+    }
+
+    // Plant the signature near the end, after any accidental earlier match
+    const uint8_t planted[] = { 0x89, 0x5C, 0x24, 0x10, 0x89, 0x44, 0x24, 0x20, 0x74, 0x05, 0x48, 0x8D, 0x15 };
+    size_t expected = size - 4096 - 3;
+    memcpy(data + expected, planted, sizeof(planted));
+    expected = find_naive(&pattern, data, size);
+
+    printf("Scanning %zu MiB for \"%s\"\n", mib, BENCH_SIGNATURE);
+    report("naive", find_naive_backend, SCAN_BACKEND_SCALAR, &pattern, data, size, expected);
+    for (ScanBackend backend = SCAN_BACKEND_SCALAR; backend <= SCAN_BACKEND_AVX2; backend++) {
+        if (scan_backendSupported(backend)) {
+            report(scan_backendName(backend), scan_findWith, backend, &pattern, data, size, expected);
+        } else {
+            printf("%-8s unsupported\n", scan_backendName(backend));
+        }
+    }
+
+    scan_freePattern(&pattern);
+    free(data);
+    return EXIT_SUCCESS;
+}
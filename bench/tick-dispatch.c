@@ -0,0 +1,139 @@
+/** \file tick-dispatch.c
+ *
+ * Benchmark for the ways of calling the auto splitter tick callbacks.
+ *
+ * Runs a small auto splitter defining all the tick callbacks, calling them
+ * one by one as run_auto_splitter does by default, then through the Lua tick
+ * driver, and reports the time per tick of both.
+ *
+ * Run it with `meson test -C build --benchmark` or directly as `tick-dispatch-bench [ticks]`.
+ */
+#include "src/lasr/dispatch/dispatch.h"
+
+#include <lauxlib.h>
+#include <lualib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 5
+
+/**
+ * An auto splitter doing a little work in every callback, like reading a few
+ * values would.
+ */
+static const char bench_script[] =
+    "local current, old = { level = 0, timer = 0, loading = false }, {}\n"
+    "local ticks = 0\n"
+    "function state()\n"
+    "    ticks = ticks + 1\n"
+    "    old.level, old.timer, old.loading = current.level, current.timer, current.loading\n"
+    "    current.level = math.floor(ticks / 1000)\n"
+    "    current.timer = ticks * 16\n"
+    "    current.loading = ticks % 500 < 10\n"
+    "end\n"
+    "function update() end\n"
+    "function gameTime() return current.timer end\n"
+    "function start() return current.level == 1 and old.level == 0 end\n"
+    "function split() return current.level > old.level end\n"
+    "function isLoading() return current.loading end\n"
+    "function reset() return current.level < old.level end\n";
+
+/**
+ * Returns the current monotonic time, in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Runs a tick calling the callbacks one by one, as run_auto_splitter does.
+ */
+static void tick_per_callback(lua_State* L, bool* started)
+{
+    bool ret;
+    int game_time;
+    dispatch_refresh(L);
+    if (dispatch_has(LASR_CALLBACK_STATE)) {
+        dispatch_call(L, LASR_CALLBACK_STATE, 0);
+    }
+    if (dispatch_has(LASR_CALLBACK_UPDATE)) {
+        dispatch_call(L, LASR_CALLBACK_UPDATE, 0);
+    }
+    if (dispatch_has(LASR_CALLBACK_GAME_TIME) && *started) {
+        dispatch_callInteger(L, LASR_CALLBACK_GAME_TIME, &game_time);
+    }
+    if (dispatch_has(LASR_CALLBACK_START) && !*started && dispatch_callBoolean(L, LASR_CALLBACK_START, &ret) && ret) {
+        *started = true;
+    }
+    if (dispatch_has(LASR_CALLBACK_SPLIT) && *started) {
+        dispatch_callBoolean(L, LASR_CALLBACK_SPLIT, &ret);
+    }
+    if (dispatch_has(LASR_CALLBACK_IS_LOADING)) {
+        dispatch_callBoolean(L, LASR_CALLBACK_IS_LOADING, &ret);
+    }
+    if (dispatch_has(LASR_CALLBACK_RESET) && dispatch_callBoolean(L, LASR_CALLBACK_RESET, &ret) && ret) {
+        *started = false;
+    }
+}
+
+/**
+ * Runs a tick through the Lua tick driver.
+ */
+static void tick_driver(lua_State* L, bool* started)
+{
+    DispatchResult result;
+    if (dispatch_tick(L, DISPATCH_USE_GAME_TIME | (*started ? DISPATCH_RUN_STARTED : 0), &result)) {
+        if (result.flags & DISPATCH_START) {
+            *started = true;
+        }
+        if (result.flags & DISPATCH_RESET) {
+            *started = false;
+        }
+    }
+}
+
+/**
+ * Prints the time per tick of a way of calling the callbacks.
+ */
+static void report(const char* name, void (*tick)(lua_State*, bool*), long ticks)
+{
+    double best = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        lua_State* L = luaL_newstate();
+        luaL_openlibs(L);
+        if (luaL_loadbuffer(L, bench_script, sizeof(bench_script) - 1, "=bench") != LUA_OK || lua_pcall(L, 0, 0, 0) != LUA_OK) {
+            fprintf(stderr, "Failed to run the benchmark script: %s\n", lua_tostring(L, -1));
+            exit(EXIT_FAILURE);
+        }
+        dispatch_watchCallbacks(L);
+        if (!dispatch_installDriver(L)) {
+            exit(EXIT_FAILURE);
+        }
+
+        bool started = false;
+        double start = now();
+        for (long i = 0; i < ticks; i++) {
+            tick(L, &started);
+        }
+        double elapsed = now() - start;
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+        lua_close(L);
+    }
+    printf("%-14s %8.1f ns/tick\n", name, best / ticks * 1e9);
+}
+
+int main(int argc, char* argv[])
+{
+    long ticks = argc > 1 ? strtol(argv[1], NULL, 10) : 1000000;
+
+    printf("Running %ld ticks\n", ticks);
+    report("per-callback", tick_per_callback, ticks);
+    report("single", tick_driver, ticks);
+    return EXIT_SUCCESS;
+}
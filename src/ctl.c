@@ -28,6 +28,8 @@ void print_help(void)
     printf("  unsplit       - Unsplit the timer\n");
     printf("  skipsplit     - Skip the current split\n");
     printf("  exit          - Closes LibreSplit\n");
+    printf("  dumpprofile   - Print the auto splitter profile to LibreSplit's output\n");
+    printf("  profiler      - Show/Hide the auto splitter profiler overlay\n");
     printf("  help          - Show this help message\n");
 }
 
@@ -122,6 +124,10 @@ int main(int argc, char* argv[])
         success = sendToLibreSplit(CTL_CMD_SKIP);
     } else if (strcmp(cmd, "exit") == 0) {
         success = sendToLibreSplit(CTL_CMD_EXIT);
+    } else if (strcmp(cmd, "dumpprofile") == 0) {
+        success = sendToLibreSplit(CTL_CMD_DUMP_PROFILE);
+    } else if (strcmp(cmd, "profiler") == 0) {
+        success = sendToLibreSplit(CTL_CMD_TOGGLE_PROFILER);
     } else {
         fprintf(stderr, "Unknown command: %s\n", cmd);
         fprintf(stderr, "Try 'help' for a list of valid commands.\n");
@@ -8,6 +8,7 @@
 #include "src/keybinds/delayed_callbacks.h"
 #include "src/keybinds/keybinds_callbacks.h"
 #include "src/lasr/auto-splitter.h"
+#include "src/lasr/profiler/profiler.h"
 #include "src/settings/settings.h"
 #include "src/settings/utils.h"
 #include <sys/stat.h>
@@ -274,6 +275,7 @@ gboolean ls_app_window_step(gpointer data)
         }
     }
     process_delayed_handlers(win);
+    profiler_drain();
 
     return TRUE;
 }
@@ -12,6 +12,7 @@ LSComponent* ls_component_prev_segment_new(void);
 LSComponent* ls_component_best_sum_new(void);
 LSComponent* ls_component_pb_new(void);
 LSComponent* ls_component_wr_new(void);
+LSComponent* ls_component_lasr_profiler_new(void);
 
 LSComponentAvailable ls_components[] = {
     { "title", ls_component_title_new },
@@ -22,5 +23,6 @@ LSComponentAvailable ls_components[] = {
     { "best-sum", ls_component_best_sum_new },
     { "pb", ls_component_pb_new },
     { "wr", ls_component_wr_new },
+    { "lasr-profiler", ls_component_lasr_profiler_new },
     { NULL, NULL }
 };
@@ -0,0 +1,135 @@
+/** \file lasr-profiler.c
+ *
+ * Implementation of the auto splitter profiler overlay component.
+ */
+#include "components.h"
+
+#include "src/lasr/profiler/profiler.h"
+
+/**
+ * How often the overlay is refreshed, in microseconds.
+ */
+#define LASR_PROFILER_REFRESH_US 250000
+
+/**
+ * @brief The component showing the timings of the auto splitter callbacks.
+ */
+typedef struct LSLasrProfiler {
+    LSComponent base; /*!< The base struct that is extended */
+    GtkWidget* container; /*!< The container for the overlay */
+    GtkWidget* table; /*!< The label containing the timings */
+    gint64 last_refresh; /*!< When the label was last refreshed */
+} LSLasrProfiler;
+extern LSComponentOps ls_lasr_profiler_operations;
+
+/**
+ * Constructor
+ */
+LSComponent* ls_component_lasr_profiler_new(void)
+{
+    LSLasrProfiler* self;
+
+    self = malloc(sizeof(LSLasrProfiler));
+    if (!self) {
+        return NULL;
+    }
+    self->base.ops = &ls_lasr_profiler_operations;
+    self->last_refresh = 0;
+
+    // Hidden until toggled with libresplit-ctl
+    self->container = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    add_class(self->container, "footer");
+    add_class(self->container, "lasr-profiler-container");
+
+    self->table = gtk_label_new(NULL);
+    add_class(self->table, "lasr-profiler");
+    gtk_widget_set_halign(self->table, GTK_ALIGN_START);
+    gtk_container_add(GTK_CONTAINER(self->container), self->table);
+    gtk_widget_show(self->table);
+
+    return (LSComponent*)self;
+}
+
+/**
+ * Destructor
+ *
+ * @param self The component to destroy
+ */
+static void lasr_profiler_delete(LSComponent* self)
+{
+    free(self);
+}
+
+/**
+ * Returns the profiler overlay GTK widget.
+ *
+ * @param self The profiler overlay component itself.
+ * @return The container as a GTK Widget.
+ */
+static GtkWidget* lasr_profiler_widget(LSComponent* self)
+{
+    return ((LSLasrProfiler*)self)->container;
+}
+
+/**
+ * Function to execute when ls_app_window_draw is executed.
+ *
+ * @param self_ The profiler overlay component itself.
+ * @param game The game struct instance.
+ * @param timer The timer instance.
+ */
+static void lasr_profiler_draw(LSComponent* self_, const ls_game* game,
+    const ls_timer* timer)
+{
+    LSLasrProfiler* self = (LSLasrProfiler*)self_;
+    if (!profiler_overlay_visible) {
+        gtk_widget_hide(self->container);
+        return;
+    }
+    gtk_widget_show(self->container);
+
+    gint64 now = g_get_monotonic_time();
+    if (now - self->last_refresh < LASR_PROFILER_REFRESH_US) {
+        return;
+    }
+    self->last_refresh = now;
+
+    const ProfilerStats* stats = &profiler_stats;
+    if (!stats->ticks.calls) {
+        gtk_label_set_text(GTK_LABEL(self->table), "No auto splitter ticks yet");
+        return;
+    }
+
+    // Times are in microseconds: last, median, 99th percentile, max
+    GString* text = g_string_new(NULL);
+    for (int i = 0; i < LASR_CALLBACK_COUNT; i++) {
+        const ProfilerTimings* timings = &stats->callbacks[i];
+        if (timings->calls) {
+            g_string_append_printf(text, "%-9s %6.0f %6.0f %6.0f %6.0f\n",
+                lasr_callback_names[i],
+                timings->last_ns / 1000.0,
+                profiler_percentile(timings, 0.5) / 1000.0,
+                profiler_percentile(timings, 0.99) / 1000.0,
+                timings->max_ns / 1000.0);
+        }
+    }
+    g_string_append_printf(text, "%-9s %6.0f %6.0f %6.0f %6.0f\n",
+        "tick",
+        stats->ticks.last_ns / 1000.0,
+        profiler_percentile(&stats->ticks, 0.5) / 1000.0,
+        profiler_percentile(&stats->ticks, 0.99) / 1000.0,
+        stats->ticks.max_ns / 1000.0);
+    g_string_append_printf(text, "reads %.1f/tick, %.0fB/tick, heap %.0fKB, alloc %.0fB/tick",
+        (double)stats->ticks.reads / stats->ticks.calls,
+        (double)stats->bytes_read / stats->ticks.calls,
+        stats->heap_bytes / 1024.0,
+        (double)stats->allocated / stats->ticks.calls);
+    gtk_label_set_text(GTK_LABEL(self->table), text->str);
+    g_string_free(text, TRUE);
+}
+
+LSComponentOps ls_lasr_profiler_operations = {
+    .delete = lasr_profiler_delete,
+    .widget = lasr_profiler_widget,
+    .draw = lasr_profiler_draw
+};
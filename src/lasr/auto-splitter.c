@@ -4,14 +4,26 @@
  */
 #include "auto-splitter.h"
 
+#include "./dispatch/dispatch.h"
+#include "./heap/heap.h"
 #include "./maps/maps.h"
+#include "./memory/arena.h"
+#include "./memory/ffi_api.h"
+#include "./memory/snapshot.h"
+#include "./process/handle.h"
+#include "./process/image.h"
+#include "./profiler/profiler.h"
+#include "./reload/reload.h"
+#include "./scan/cache.h"
+#include "./scheduler/scheduler.h"
+#include "./watch/watch.h"
 #include "functions.h"
 #include "utils.h"
 
+#include <inttypes.h>
 #include <lauxlib.h>
 #include <lua.h>
 #include <lualib.h>
-#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -22,6 +34,10 @@
 char auto_splitter_file[PATH_MAX]; /*!< The loaded auto splitter file path */
 int refresh_rate = 60; /*!< The Auto Splitter's refresh rate applied */
 bool use_game_time = false; /*!< Enables IGT */
+bool realtime_ticks = false; /*!< Lowers the timer slack and uses real-time scheduling for the ticks */
+bool single_dispatch = false; /*!< Runs all the callbacks of a tick in a single call to the Lua tick driver */
+bool snapshot_reads = false; /*!< Serves the memory reads of a tick from a snapshot of the game memory */
+bool idle_gc = false; /*!< Runs the garbage collector between the ticks instead of during them */
 atomic_bool update_game_time = false; /*!< True if the auto splitter is requesting the game time to be updated */
 atomic_llong game_time_value = 0; /*!< The in-game time value, in milliseconds */
 
@@ -69,17 +85,6 @@ static const char* disabled_functions[] = {
     NULL
 };
 
-/**
- * Check if the game process exists and is running.
- *
- * @returns Zero if the process is not running, non-zero if it is.
- */
-static int process_exists(void)
-{
-    int result = kill(process.pid, 0);
-    return result == 0;
-}
-
 /**
  * Lua libraries to enable in LASR
  */
@@ -101,10 +106,15 @@ static const lasr_function luac_functions[] = {
     { "process", find_process_id },
     { "getBaseAddress", getBaseAddress },
     { "readAddress", readAddress },
+    { "readBatch", readBatch },
+    { "compileRead", compileRead },
+    { "watch", watch },
     { "sizeOf", size_of },
     { "sig_scan", perform_sig_scan },
+    { "sig_scan_many", perform_sig_scan_many },
     { "getPID", getPID },
     { "getModuleSize", getModuleSize },
+    { "addressToModule", addressToModule },
     { "shallow_copy_tbl", shallow_copy_tbl },
     { "print_tbl", print_tbl },
     { "b_and", b_and },
@@ -114,6 +124,7 @@ static const lasr_function luac_functions[] = {
     { "b_lshift", b_lshift },
     { "b_rshift", b_rshift },
     { "getMaps", getMaps },
+    { "getTickStats", getTickStats },
     { NULL, NULL }
 };
 
@@ -161,120 +172,6 @@ void disable_functions(lua_State* L, const char** functions)
     }
 }
 
-/**
-    Generic function to call lua functions
-    Signatures are something like `disb>s`
-    1. d = double
-    2. i = int
-    3. s = string
-    4. b = boolean
-    5. > = return separator
-
-    Example: `call_va("functionName", "dd>d", x, y, &z);`
-    Calls "functionName" with two doubles as parameters (x and y), returning a double in z
-*/
-bool call_va(lua_State* L, const char* func, const char* sig, ...)
-{
-    va_list vl;
-    int narg, nres; /* number of arguments and results */
-
-    va_start(vl, sig);
-    lua_getglobal(L, func); /* get function */
-
-    /* push arguments */
-    narg = 0;
-    while (*sig) { /* push arguments */
-        switch (*sig++) {
-            case 'd': /* double argument */
-                lua_pushnumber(L, va_arg(vl, double));
-                break;
-
-            case 'i': /* int argument */
-                lua_pushnumber(L, va_arg(vl, int));
-                break;
-
-            case 's': /* string argument */
-                lua_pushstring(L, va_arg(vl, char*));
-                break;
-
-            case 'b':
-                lua_pushboolean(L, va_arg(vl, int));
-                break;
-
-            case '>':
-                break;
-
-            default:
-                printf("invalid option (%c)\n", *(sig - 1));
-                return false;
-        }
-        if (*(sig - 1) == '>')
-            break;
-        narg++;
-        luaL_checkstack(L, 1, "too many arguments");
-    }
-
-    /* do the call */
-    nres = strlen(sig); /* number of expected results */
-    if (lua_pcall(L, narg, nres, 0) != LUA_OK) {
-        const char* err = lua_tostring(L, -1);
-        printf("error running function '%s': %s\n", func, err);
-        va_end(vl);
-        return false;
-    }
-
-    /* retrieve results */
-    nres = -nres; /* stack index of first result */
-    /* check if there's a return value */
-    if (!lua_isnil(L, nres)) {
-        while (*sig) { /* get results */
-            switch (*sig++) {
-                case 'd': /* double result */
-                    if (!lua_isnumber(L, nres)) {
-                        printf("function '%s' wrong result type, expected double\n", func);
-                        return false;
-                    }
-                    *va_arg(vl, double*) = lua_tonumber(L, nres);
-                    break;
-
-                case 'i': /* int result */
-                    if (!lua_isnumber(L, nres)) {
-                        printf("function '%s' wrong result type, expected int\n", func);
-                        return false;
-                    }
-                    *va_arg(vl, int*) = lua_tointeger(L, nres);
-                    break;
-
-                case 's': /* string result */
-                    if (!lua_isstring(L, nres)) {
-                        printf("function '%s' wrong result type, expected string\n", func);
-                        return false;
-                    }
-                    *va_arg(vl, const char**) = lua_tostring(L, nres);
-                    break;
-
-                case 'b':
-                    if (!lua_isboolean(L, nres)) {
-                        printf("function '%s' wrong result type, expected boolean\n", func);
-                        return false;
-                    }
-                    *va_arg(vl, bool*) = lua_toboolean(L, nres);
-                    break;
-
-                default:
-                    printf("invalid option (%c)\n", *(sig - 1));
-                    return false;
-            }
-            nres++;
-        }
-    } else {
-        va_end(vl);
-        return false;
-    }
-    va_end(vl);
-    return true;
-}
-
 /**
  * The startup() LASR function.
  *
@@ -286,7 +183,9 @@ bool call_va(lua_State* L, const char* func, const char* sig, ...)
 void startup(lua_State* L)
 {
     lua_getglobal(L, "startup");
+    heap_enforceLimit(true);
     lua_pcall(L, 0, 0, 0);
+    heap_enforceLimit(false);
 
     lua_getglobal(L, "refreshRate");
     if (lua_isnumber(L, -1)) {
@@ -306,6 +205,55 @@ void startup(lua_State* L)
         use_game_time = lua_toboolean(L, -1);
     }
     lua_pop(L, 1); // Remove 'useGameTime' from the stack
+
+    lua_getglobal(L, "realtimeTicks");
+    if (lua_isboolean(L, -1)) {
+        realtime_ticks = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1); // Remove 'realtimeTicks' from the stack
+
+    lua_getglobal(L, "singleDispatch");
+    if (lua_isboolean(L, -1)) {
+        single_dispatch = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1); // Remove 'singleDispatch' from the stack
+
+    lua_getglobal(L, "snapshotReads");
+    if (lua_isboolean(L, -1)) {
+        snapshot_reads = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1); // Remove 'snapshotReads' from the stack
+
+    lua_getglobal(L, "idleGC");
+    if (lua_isboolean(L, -1)) {
+        idle_gc = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1); // Remove 'idleGC' from the stack
+
+    lua_getglobal(L, "memoryLimit");
+    if (lua_isnumber(L, -1)) {
+        lua_Number limit = lua_tonumber(L, -1);
+        if (limit >= 0 && limit <= SIZE_MAX / (1024 * 1024)) {
+            size_t applied = heap_setLimit((size_t)(limit * 1024 * 1024));
+            if (applied && applied > limit * 1024 * 1024) {
+                printf("[memoryLimit] The script already uses more memory, raising the limit to %zuMB\n", applied / (1024 * 1024));
+            }
+        } else {
+            printf("[memoryLimit] The memory limit must be a number of megabytes, keeping %zuMB\n", heap_stats.limit / (1024 * 1024));
+        }
+    }
+    lua_pop(L, 1); // Remove 'memoryLimit' from the stack
+
+    lua_getglobal(L, "pointerSize");
+    if (lua_isnumber(L, -1)) {
+        lua_Integer pointer_size = lua_tointeger(L, -1);
+        if (pointer_size == 4 || pointer_size == 8) {
+            process.pointer_size = pointer_size;
+        } else {
+            printf("[pointerSize] The pointer size must be 4 or 8, keeping %u\n", process.pointer_size);
+        }
+    }
+    lua_pop(L, 1); // Remove 'pointerSize' from the stack
 }
 
 /**
@@ -317,7 +265,7 @@ void startup(lua_State* L)
  */
 void state(lua_State* L)
 {
-    call_va(L, "state", "");
+    dispatch_call(L, LASR_CALLBACK_STATE, 0);
 }
 
 /**
@@ -329,7 +277,20 @@ void state(lua_State* L)
  */
 void update(lua_State* L)
 {
-    call_va(L, "update", "");
+    dispatch_call(L, LASR_CALLBACK_UPDATE, 0);
+}
+
+/**
+ * Stores the result of the start() LASR function.
+ *
+ * @param ret True if the run has to start.
+ */
+static void apply_start(bool ret)
+{
+    atomic_store(&call_start, ret);
+    if (ret) {
+        atomic_store(&run_started, true);
+    }
 }
 
 /**
@@ -343,13 +304,9 @@ void update(lua_State* L)
 void start(lua_State* L)
 {
     bool ret;
-    if (call_va(L, "start", ">b", &ret)) {
-        atomic_store(&call_start, ret);
-        if (ret) {
-            atomic_store(&run_started, true);
-        }
+    if (dispatch_callBoolean(L, LASR_CALLBACK_START, &ret)) {
+        apply_start(ret);
     }
-    lua_pop(L, 1); // Remove the return value from the stack
 }
 
 /**
@@ -362,10 +319,22 @@ void start(lua_State* L)
 void split(lua_State* L)
 {
     bool ret;
-    if (call_va(L, "split", ">b", &ret)) {
+    if (dispatch_callBoolean(L, LASR_CALLBACK_SPLIT, &ret)) {
         atomic_store(&call_split, ret);
     }
-    lua_pop(L, 1); // Remove the return value from the stack
+}
+
+/**
+ * Stores the result of the isLoading() LASR function.
+ *
+ * @param loading True if the game is loading.
+ */
+static void apply_is_loading(bool loading)
+{
+    if (loading != prev_is_loading) {
+        atomic_store(&toggle_loading, true);
+        prev_is_loading = !prev_is_loading;
+    }
 }
 
 /**
@@ -379,13 +348,9 @@ void split(lua_State* L)
 void is_loading(lua_State* L)
 {
     bool loading;
-    if (call_va(L, "isLoading", ">b", &loading)) {
-        if (loading != prev_is_loading) {
-            atomic_store(&toggle_loading, true);
-            prev_is_loading = !prev_is_loading;
-        }
+    if (dispatch_callBoolean(L, LASR_CALLBACK_IS_LOADING, &loading)) {
+        apply_is_loading(loading);
     }
-    lua_pop(L, 1); // Remove the return value from the stack
 }
 
 /**
@@ -399,11 +364,22 @@ void is_loading(lua_State* L)
 void reset(lua_State* L)
 {
     bool shouldReset;
-    if (call_va(L, "reset", ">b", &shouldReset)) {
+    if (dispatch_callBoolean(L, LASR_CALLBACK_RESET, &shouldReset)) {
         if (shouldReset)
             atomic_store(&call_reset, true);
     }
-    lua_pop(L, 1); // Remove the return value from the stack
+}
+
+/**
+ * Stores the result of the gameTime() LASR function.
+ *
+ * @param gameTime The game time, in milliseconds.
+ */
+static void apply_game_time(int gameTime)
+{
+    // Convert gameTime from milliseconds to the expected time format and update the timer
+    atomic_store(&game_time_value, (long long)gameTime * 1000);
+    atomic_store(&update_game_time, true);
 }
 
 /**
@@ -417,140 +393,366 @@ void reset(lua_State* L)
 void gameTime(lua_State* L)
 {
     int gameTime;
-    if (call_va(L, "gameTime", ">i", &gameTime)) {
-        // Convert gameTime from milliseconds to the expected time format and update the timer
-        atomic_store(&game_time_value, (long long)gameTime * 1000);
-        atomic_store(&update_game_time, true);
+    if (dispatch_callInteger(L, LASR_CALLBACK_GAME_TIME, &gameTime)) {
+        apply_game_time(gameTime);
     }
-    lua_pop(L, 1); // Remove the return value from the stack
 }
 
 /**
- * Loads the auto splitter Lua file and executes the auto splitter.
+ * Runs all the LASR functions of a tick in a single call to the Lua tick driver.
+ *
+ * The functions are called in the same order and under the same conditions
+ * as when they are called one by one.
+ *
+ * @param L The Lua State
  */
-void run_auto_splitter(void)
+static void dispatch_all(lua_State* L)
 {
-    lua_State* L = luaL_newstate();
-    luaL_openlibs(L);
-    disable_functions(L, disabled_functions);
-    push_lasr_functions(L, luac_functions);
+    unsigned flags = 0;
+    if (atomic_load(&run_started)) {
+        flags |= DISPATCH_RUN_STARTED;
+    }
+    if (atomic_load(&run_finished)) {
+        flags |= DISPATCH_RUN_FINISHED;
+    }
+    if (use_game_time) {
+        flags |= DISPATCH_USE_GAME_TIME;
+    }
 
-    char current_file[PATH_MAX];
-    strcpy(current_file, auto_splitter_file);
+    DispatchResult result;
+    if (!dispatch_tick(L, flags, &result)) {
+        return;
+    }
+    if (result.flags & DISPATCH_GAME_TIME_VALID) {
+        apply_game_time(result.game_time);
+    }
+    if (result.flags & DISPATCH_START_VALID) {
+        apply_start(result.flags & DISPATCH_START);
+    }
+    if (result.flags & DISPATCH_SPLIT_VALID) {
+        atomic_store(&call_split, result.flags & DISPATCH_SPLIT);
+    }
+    if (result.flags & DISPATCH_LOADING_VALID) {
+        apply_is_loading(result.flags & DISPATCH_LOADING);
+    }
+    if (result.flags & DISPATCH_RESET) {
+        atomic_store(&call_reset, true);
+    }
+}
 
+/**
+ * Registry reference to the globals table the auto splitters start from,
+ * holding the libraries and the LASR functions.
+ */
+static int base_globals_ref = LUA_NOREF;
+
+/**
+ * Pushes a shallow copy of a table.
+ *
+ * @param L The Lua State
+ * @param index The stack index of the table, must be positive.
+ */
+static void push_table_copy(lua_State* L, int index)
+{
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, index) != 0) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -4);
+    }
+}
+
+/**
+ * Pushes a fresh copy of the base globals.
+ *
+ * The library tables (`string`, `math`, `memory`, ...) are copied as well, so
+ * what a script changes in them doesn't outlive it, and `_G` and the string
+ * methods refer to the copies.
+ *
+ * @param L The Lua State
+ */
+static void push_fresh_globals(lua_State* L)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, base_globals_ref);
+    int base = lua_gettop(L);
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, base) != 0) {
+        if (lua_istable(L, -1) && !lua_rawequal(L, -1, base)) {
+            push_table_copy(L, lua_gettop(L));
+            lua_replace(L, -2);
+        }
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, base + 1);
+    }
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "_G");
+    lua_remove(L, base); // Remove the base globals from the stack
+
+    // String methods come from the copy of `string`, like they came from the original
+    lua_pushliteral(L, "");
+    if (lua_getmetatable(L, -1)) {
+        lua_getfield(L, -3, "string");
+        lua_setfield(L, -2, "__index");
+        lua_pop(L, 1); // Remove the metatable from the stack
+    }
+    lua_pop(L, 1); // Remove the string from the stack
+}
+
+/**
+ * Resets the settings of the auto splitter to their defaults, before its
+ * startup() changes them.
+ *
+ * The pointer size detected from the game is restored as well, in case the
+ * previous version of the script forced it.
+ */
+static void reset_settings(void)
+{
+    refresh_rate = 60;
+    use_game_time = false;
+    realtime_ticks = false;
+    single_dispatch = false;
+    snapshot_reads = false;
+    idle_gc = false;
+    maps_cache_cycles = 1;
+    maps_cache_cycles_value = 1;
+    heap_setLimit(HEAP_DEFAULT_LIMIT);
+    process.pointer_size = process.pid ? image_pointerSize(process.base_address) : 0;
+}
+
+/**
+ * Loads the auto splitter file, runs it in a fresh copy of the base globals
+ * and sets up its callbacks.
+ *
+ * When reloading, the previous version keeps running if the file has syntax
+ * errors. Runtime errors are only printed, since the previous version can't be
+ * restored once the new one started running.
+ *
+ * @param L The Lua State
+ * @param file The path of the auto splitter file.
+ * @param reloading True if a previous version of the file is running.
+ *
+ * @return False if the file couldn't be loaded, or couldn't be run the first
+ * time.
+ */
+static bool load_auto_splitter(lua_State* L, const char* file, bool reloading)
+{
     // Load the Lua file
-    if (luaL_loadfile(L, auto_splitter_file) != LUA_OK) {
+    if (luaL_loadfile(L, file) != LUA_OK) {
         // Error loading the file
         const char* error_msg = lua_tostring(L, -1);
-        lua_pop(L, 1); // Remove the error message from the stack
         fprintf(stderr, "Lua syntax error: %s\n", error_msg);
-        lua_close(L);
-        atomic_store(&auto_splitter_enabled, false);
-        return;
+        lua_pop(L, 1); // Remove the error message from the stack
+        if (reloading) {
+            printf("Keeping the running version of %s\n", file);
+        }
+        return false;
+    }
+    if (reloading) {
+        dispatch_release(L);
     }
 
+    // Nothing the previous version defined survives the reload
+    push_fresh_globals(L);
+    lua_pushvalue(L, -1);
+    lua_replace(L, LUA_GLOBALSINDEX);
+    lua_setfenv(L, -2); // The chunk was loaded with the previous globals
+    watch_open(L);
+    reset_settings();
+
     // Execute the Lua file
-    if (lua_pcall(L, 0, LUA_MULTRET, 0) != LUA_OK) {
+    heap_enforceLimit(true);
+    int status = lua_pcall(L, 0, 0, 0);
+    heap_enforceLimit(false);
+    if (status != LUA_OK) {
         // Error executing the file
         const char* error_msg = lua_tostring(L, -1);
-        lua_pop(L, 1); // Remove the error message from the stack
         fprintf(stderr, "Lua runtime error: %s\n", error_msg);
-        lua_close(L);
-        atomic_store(&auto_splitter_enabled, false);
-        return;
+        lua_pop(L, 1); // Remove the error message from the stack
+        if (!reloading) {
+            return false;
+        }
     }
 
-    lua_getglobal(L, "state");
-    bool state_exists = lua_isfunction(L, -1);
-    lua_pop(L, 1); // Remove 'state' from the stack
-
-    lua_getglobal(L, "start");
-    bool start_exists = lua_isfunction(L, -1);
-    lua_pop(L, 1); // Remove 'start' from the stack
-
-    lua_getglobal(L, "split");
-    bool split_exists = lua_isfunction(L, -1);
-    lua_pop(L, 1); // Remove 'split' from the stack
-
-    lua_getglobal(L, "isLoading");
-    bool is_loading_exists = lua_isfunction(L, -1);
-    lua_pop(L, 1); // Remove 'isLoading' from the stack
-
     lua_getglobal(L, "startup");
     bool startup_exists = lua_isfunction(L, -1);
     lua_pop(L, 1); // Remove 'startup' from the stack
 
-    lua_getglobal(L, "reset");
-    bool reset_exists = lua_isfunction(L, -1);
-    lua_pop(L, 1); // Remove 'reset' from the stack
+    if (startup_exists) {
+        startup(L);
+    }
+    dispatch_watchCallbacks(L);
+    if (single_dispatch && !dispatch_installDriver(L)) {
+        single_dispatch = false;
+    }
+    lua_gc(L, idle_gc ? LUA_GCSTOP : LUA_GCRESTART, 0);
+    return true;
+}
 
-    lua_getglobal(L, "update");
-    bool update_exists = lua_isfunction(L, -1);
-    lua_pop(L, 1); // Remove 'update' from the stack
+/**
+ * Reloads the auto splitter file after it was saved.
+ *
+ * The Lua State, the game process and its pidfd, the memory maps cache and
+ * the signature cache are kept, only the script starts over.
+ *
+ * @param L The Lua State
+ * @param file The path of the auto splitter file.
+ */
+static void reload_auto_splitter(lua_State* L, const char* file)
+{
+    int previous_rate = refresh_rate;
+    bool previous_realtime = realtime_ticks;
 
-    lua_getglobal(L, "gameTime");
-    bool gameTime_exists = lua_isfunction(L, -1);
-    lua_pop(L, 1); // Remove 'gameTime' from the stack
+    printf("Reloading %s\n", file);
+    if (!load_auto_splitter(L, file, true)) {
+        return;
+    }
+    if (refresh_rate != previous_rate || realtime_ticks != previous_realtime) {
+        printf("Refresh rate: %d\n", refresh_rate);
+        scheduler_free(&tick_scheduler);
+        scheduler_init(&tick_scheduler, refresh_rate, realtime_ticks);
+    }
+    profiler_startSession();
+}
 
-    if (startup_exists) {
-        startup(L);
+/**
+ * Loads the auto splitter Lua file and executes the auto splitter.
+ *
+ * The file is reloaded whenever it is saved, until another file is chosen.
+ */
+void run_auto_splitter(void)
+{
+    lua_State* L = heap_newState();
+    if (!L) {
+        fprintf(stderr, "Failed to create the Lua State\n");
+        atomic_store(&auto_splitter_enabled, false);
+        return;
+    }
+    luaL_openlibs(L);
+    disable_functions(L, disabled_functions);
+    push_lasr_functions(L, luac_functions);
+    ffiapi_open(L);
+    lua_pushvalue(L, LUA_GLOBALSINDEX);
+    base_globals_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    char current_file[PATH_MAX];
+    strcpy(current_file, auto_splitter_file);
+
+    if (!load_auto_splitter(L, current_file, false)) {
+        watch_clear(L);
+        lua_close(L);
+        heap_free();
+        atomic_store(&auto_splitter_enabled, false);
+        return;
     }
+    reload_watch(current_file);
 
     printf("Refresh rate: %d\n", refresh_rate);
-    int rate = 1000000 / refresh_rate;
+    scheduler_init(&tick_scheduler, refresh_rate, realtime_ticks);
+    profiler_startSession();
+    ProfilerTick tick;
 
     while (1) {
-        struct timespec clock_start;
-        clock_gettime(CLOCK_MONOTONIC, &clock_start);
-
-        if (!atomic_load(&auto_splitter_enabled) || strcmp(current_file, auto_splitter_file) != 0 || !process_exists() || process.pid == 0) {
+        if (!atomic_load(&auto_splitter_enabled) || strcmp(current_file, auto_splitter_file) != 0 || process.pid == 0) {
             break;
         }
 
-        if (state_exists) {
-            state(L);
+        if (reload_changed()) {
+            reload_auto_splitter(L, current_file);
         }
 
-        if (update_exists) {
-            update(L);
+        profiler_beginTick(&tick, L);
+        if (snapshot_reads) {
+            snapshot_begin(process.pid);
         }
+        watch_refresh();
+
+        if (single_dispatch) {
+            heap_enforceLimit(true);
+            dispatch_all(L);
+        } else {
+            dispatch_refresh(L);
+            heap_enforceLimit(true);
+
+            if (dispatch_has(LASR_CALLBACK_STATE)) {
+                profiler_beginCallback(&tick);
+                state(L);
+                profiler_endCallback(&tick, LASR_CALLBACK_STATE);
+            }
 
-        if (gameTime_exists && use_game_time && atomic_load(&run_started) && !atomic_load(&run_finished)) {
-            gameTime(L);
-        }
+            if (dispatch_has(LASR_CALLBACK_UPDATE)) {
+                profiler_beginCallback(&tick);
+                update(L);
+                profiler_endCallback(&tick, LASR_CALLBACK_UPDATE);
+            }
 
-        if (start_exists && !atomic_load(&run_started) && !atomic_load(&run_finished)) {
-            start(L);
-        }
+            if (dispatch_has(LASR_CALLBACK_GAME_TIME) && use_game_time && atomic_load(&run_started) && !atomic_load(&run_finished)) {
+                profiler_beginCallback(&tick);
+                gameTime(L);
+                profiler_endCallback(&tick, LASR_CALLBACK_GAME_TIME);
+            }
 
-        if (split_exists && atomic_load(&run_started)) {
-            split(L);
-        }
+            if (dispatch_has(LASR_CALLBACK_START) && !atomic_load(&run_started) && !atomic_load(&run_finished)) {
+                profiler_beginCallback(&tick);
+                start(L);
+                profiler_endCallback(&tick, LASR_CALLBACK_START);
+            }
 
-        if (is_loading_exists) {
-            is_loading(L);
-        }
+            if (dispatch_has(LASR_CALLBACK_SPLIT) && atomic_load(&run_started)) {
+                profiler_beginCallback(&tick);
+                split(L);
+                profiler_endCallback(&tick, LASR_CALLBACK_SPLIT);
+            }
+
+            if (dispatch_has(LASR_CALLBACK_IS_LOADING)) {
+                profiler_beginCallback(&tick);
+                is_loading(L);
+                profiler_endCallback(&tick, LASR_CALLBACK_IS_LOADING);
+            }
 
-        if (reset_exists) {
-            reset(L);
+            if (dispatch_has(LASR_CALLBACK_RESET)) {
+                profiler_beginCallback(&tick);
+                reset(L);
+                profiler_endCallback(&tick, LASR_CALLBACK_RESET);
+            }
         }
+        heap_enforceLimit(false);
+
+        snapshot_end();
 
-        // Clear the memory maps cache if needed
+        // Mark the memory maps cache as outdated if needed
         maps_cache_cycles_value--;
         if (maps_cache_cycles_value < 1) {
-            maps_clearCache();
+            maps_invalidate();
             maps_cache_cycles_value = maps_cache_cycles;
             // printf("Cleared maps cache\n");
         }
 
-        struct timespec clock_end;
-        clock_gettime(CLOCK_MONOTONIC, &clock_end);
-        long long duration = (clock_end.tv_sec - clock_start.tv_sec) * 1000000 + (clock_end.tv_nsec - clock_start.tv_nsec) / 1000;
-        // printf("duration: %llu\n", duration);
-        if (duration < rate) {
-            usleep(rate - duration);
+        profiler_endTick(&tick, L);
+
+        // Everything the functions allocated during the tick is freed at once
+        arena_reset();
+
+        // Collect the garbage with half of the time left until the next tick
+        heap_endTick(L, idle_gc, scheduler_remaining(&tick_scheduler) / 2);
+
+        // Sleep until the next tick, waking up early if the game exits
+        bool exited = scheduler_wait(&tick_scheduler, process.pidfd);
+        if (exited || (process.pidfd < 0 && !process_isRunning())) {
+            break;
         }
     }
 
+    reload_stop();
+    scheduler_free(&tick_scheduler);
+    printf("Ticks: %" PRIu64 ", overruns: %" PRIu64 ", max jitter: %ldus\n", tick_scheduler.ticks, tick_scheduler.overruns, tick_scheduler.max_jitter_ns / 1000);
+    maps_clearCache();
+    scan_cacheClose();
+    process_detach();
+    watch_clear(L);
     lua_close(L);
+    heap_free();
+    arena_free();
 }
@@ -8,6 +8,10 @@
 extern char auto_splitter_file[PATH_MAX];
 extern int refresh_rate;
 extern bool use_game_time;
+extern bool realtime_ticks;
+extern bool single_dispatch;
+extern bool snapshot_reads;
+extern bool idle_gc;
 extern atomic_bool update_game_time;
 extern atomic_llong game_time_value;
 extern int maps_cache_cycles;
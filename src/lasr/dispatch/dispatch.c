@@ -0,0 +1,376 @@
+/** \file dispatch.c
+ *
+ * Calls of the auto splitter tick callbacks.
+ *
+ * Callbacks are called through registry references rather than looked up by
+ * name on every tick. Alternatively, a tick driver written in Lua can call all
+ * of them in a single lua_pcall, so LuaJIT can trace the whole tick.
+ */
+#include "dispatch.h"
+
+#include <lauxlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * The Lua names of the tick callbacks.
+ */
+const char* lasr_callback_names[LASR_CALLBACK_COUNT] = {
+    [LASR_CALLBACK_STATE] = "state",
+    [LASR_CALLBACK_UPDATE] = "update",
+    [LASR_CALLBACK_GAME_TIME] = "gameTime",
+    [LASR_CALLBACK_START] = "start",
+    [LASR_CALLBACK_SPLIT] = "split",
+    [LASR_CALLBACK_IS_LOADING] = "isLoading",
+    [LASR_CALLBACK_RESET] = "reset",
+};
+
+/**
+ * Registry references to the tick callbacks, LUA_NOREF for the missing ones.
+ */
+static int callback_refs[LASR_CALLBACK_COUNT];
+
+/**
+ * True if a callback was assigned since the references were resolved.
+ */
+static bool callbacks_dirty = true;
+
+/**
+ * Registry reference to the table holding the tick callbacks.
+ */
+static int callbacks_table_ref = LUA_NOREF;
+
+/**
+ * Registry reference to the tick driver, LUA_NOREF if it isn't installed.
+ */
+static int driver_ref = LUA_NOREF;
+
+/**
+ * The __newindex metamethod of the globals table.
+ *
+ * The tick callbacks are kept in the table given as upvalue instead of the
+ * globals table, so every assignment to them ends up here and marks the
+ * references as outdated. Other new globals are stored as usual.
+ *
+ * @param L The Lua State
+ */
+static int globals_newindex(lua_State* L)
+{
+    lua_settop(L, 3);
+    if (lua_type(L, 2) == LUA_TSTRING) {
+        const char* key = lua_tostring(L, 2);
+        for (int i = 0; i < LASR_CALLBACK_COUNT; i++) {
+            if (strcmp(key, lasr_callback_names[i]) == 0) {
+                lua_rawset(L, lua_upvalueindex(1));
+                callbacks_dirty = true;
+                return 0;
+            }
+        }
+    }
+    lua_rawset(L, 1);
+    return 0;
+}
+
+/**
+ * Moves the tick callbacks out of the globals table, so that assigning them
+ * can be detected.
+ *
+ * Must be called once on every new Lua State, before the other functions.
+ *
+ * Reading them from Lua still works, through the __index metamethod of the
+ * globals table. Scripts can't remove the metatable, as setmetatable and
+ * rawset are disabled.
+ *
+ * @param L The Lua State
+ */
+void dispatch_watchCallbacks(lua_State* L)
+{
+    driver_ref = LUA_NOREF;
+    lua_createtable(L, 0, LASR_CALLBACK_COUNT);
+    for (int i = 0; i < LASR_CALLBACK_COUNT; i++) {
+        callback_refs[i] = LUA_NOREF;
+        lua_getglobal(L, lasr_callback_names[i]);
+        lua_setfield(L, -2, lasr_callback_names[i]);
+        lua_pushnil(L);
+        lua_setglobal(L, lasr_callback_names[i]);
+    }
+
+    lua_createtable(L, 0, 2);
+    lua_pushvalue(L, -2);
+    lua_setfield(L, -2, "__index");
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, globals_newindex, 1);
+    lua_setfield(L, -2, "__newindex");
+    lua_setmetatable(L, LUA_GLOBALSINDEX);
+    callbacks_table_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    callbacks_dirty = true;
+}
+
+/**
+ * Drops the references to the tick callbacks and the tick driver, so they can
+ * be collected when the auto splitter is reloaded.
+ *
+ * dispatch_watchCallbacks must be called again before the other functions.
+ *
+ * @param L The Lua State
+ */
+void dispatch_release(lua_State* L)
+{
+    for (int i = 0; i < LASR_CALLBACK_COUNT; i++) {
+        luaL_unref(L, LUA_REGISTRYINDEX, callback_refs[i]);
+        callback_refs[i] = LUA_NOREF;
+    }
+    luaL_unref(L, LUA_REGISTRYINDEX, callbacks_table_ref);
+    callbacks_table_ref = LUA_NOREF;
+    luaL_unref(L, LUA_REGISTRYINDEX, driver_ref);
+    driver_ref = LUA_NOREF;
+}
+
+/**
+ * Takes registry references to the current tick callbacks, if they changed
+ * since the last call.
+ *
+ * @param L The Lua State
+ */
+void dispatch_refresh(lua_State* L)
+{
+    if (!callbacks_dirty) {
+        return;
+    }
+    for (int i = 0; i < LASR_CALLBACK_COUNT; i++) {
+        luaL_unref(L, LUA_REGISTRYINDEX, callback_refs[i]);
+        lua_getglobal(L, lasr_callback_names[i]);
+        if (lua_isfunction(L, -1)) {
+            callback_refs[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+        } else {
+            callback_refs[i] = LUA_NOREF;
+            lua_pop(L, 1); // Remove the non-function from the stack
+        }
+    }
+    callbacks_dirty = false;
+}
+
+/**
+ * Checks if the auto splitter defines a tick callback.
+ *
+ * @param callback The callback.
+ *
+ * @return True if the callback is a function.
+ */
+bool dispatch_has(LasrCallback callback)
+{
+    return callback_refs[callback] != LUA_NOREF;
+}
+
+/**
+ * Calls a tick callback without arguments, printing its errors.
+ *
+ * @param L The Lua State
+ * @param callback The callback, which must exist.
+ * @param results The number of results to keep on the stack.
+ *
+ * @return True if the callback succeeded, its results are then on the stack.
+ */
+bool dispatch_call(lua_State* L, LasrCallback callback, int results)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, callback_refs[callback]);
+    if (lua_pcall(L, 0, results, 0) != LUA_OK) {
+        printf("error running function '%s': %s\n", lasr_callback_names[callback], lua_tostring(L, -1));
+        lua_pop(L, 1); // Remove the error message from the stack
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Calls a tick callback returning a boolean.
+ *
+ * @param L The Lua State
+ * @param callback The callback, which must exist.
+ * @param[out] result The returned boolean.
+ *
+ * @return True if the callback succeeded and returned a boolean.
+ */
+bool dispatch_callBoolean(lua_State* L, LasrCallback callback, bool* result)
+{
+    if (!dispatch_call(L, callback, 1)) {
+        return false;
+    }
+    bool valid = lua_isboolean(L, -1);
+    if (valid) {
+        *result = lua_toboolean(L, -1);
+    } else if (!lua_isnil(L, -1)) {
+        printf("function '%s' wrong result type, expected boolean\n", lasr_callback_names[callback]);
+    }
+    lua_pop(L, 1); // Remove the return value from the stack
+    return valid;
+}
+
+/**
+ * Calls a tick callback returning an integer.
+ *
+ * @param L The Lua State
+ * @param callback The callback, which must exist.
+ * @param[out] result The returned integer.
+ *
+ * @return True if the callback succeeded and returned a number.
+ */
+bool dispatch_callInteger(lua_State* L, LasrCallback callback, int* result)
+{
+    if (!dispatch_call(L, callback, 1)) {
+        return false;
+    }
+    bool valid = lua_isnumber(L, -1);
+    if (valid) {
+        *result = lua_tointeger(L, -1);
+    } else if (!lua_isnil(L, -1)) {
+        printf("function '%s' wrong result type, expected int\n", lasr_callback_names[callback]);
+    }
+    lua_pop(L, 1); // Remove the return value from the stack
+    return valid;
+}
+
+/**
+ * Source of the tick driver.
+ *
+ * The chunk receives the table holding the callbacks and the values of the
+ * DispatchFlag and DispatchResultFlag constants. It returns the driver, which
+ * calls the callbacks in the same order and under the same conditions as
+ * run_auto_splitter does one by one, and returns the DispatchResultFlag values
+ * along with the game time.
+ */
+static const char driver_source[] =
+    "local callbacks, RUN_STARTED, RUN_FINISHED, USE_GAME_TIME,\n"
+    "    START_VALID, START, SPLIT_VALID, SPLIT, RESET, LOADING_VALID, LOADING, GAME_TIME_VALID = ...\n"
+    "local band, type, print = bit.band, type, print\n"
+    "\n"
+    "local function valid(name, value, expected)\n"
+    "    local kind = type(value)\n"
+    "    if kind == expected then\n"
+    "        return true\n"
+    "    end\n"
+    "    if kind ~= 'nil' then\n"
+    "        print(\"function '\" .. name .. \"' wrong result type, expected \" .. expected)\n"
+    "    end\n"
+    "    return false\n"
+    "end\n"
+    "\n"
+    "return function(flags)\n"
+    "    local started = band(flags, RUN_STARTED) ~= 0\n"
+    "    local finished = band(flags, RUN_FINISHED) ~= 0\n"
+    "    local result, game_time = 0, 0\n"
+    "    local f = callbacks.state\n"
+    "    if type(f) == 'function' then\n"
+    "        f()\n"
+    "    end\n"
+    "    f = callbacks.update\n"
+    "    if type(f) == 'function' then\n"
+    "        f()\n"
+    "    end\n"
+    "    f = callbacks.gameTime\n"
+    "    if type(f) == 'function' and band(flags, USE_GAME_TIME) ~= 0 and started and not finished then\n"
+    "        local value = f()\n"
+    "        if valid('gameTime', value, 'number') then\n"
+    "            result, game_time = result + GAME_TIME_VALID, value\n"
+    "        end\n"
+    "    end\n"
+    "    f = callbacks.start\n"
+    "    if type(f) == 'function' and not started and not finished then\n"
+    "        local value = f()\n"
+    "        if valid('start', value, 'boolean') then\n"
+    "            result = result + START_VALID + (value and START or 0)\n"
+    "            started = value\n"
+    "        end\n"
+    "    end\n"
+    "    f = callbacks.split\n"
+    "    if type(f) == 'function' and started then\n"
+    "        local value = f()\n"
+    "        if valid('split', value, 'boolean') then\n"
+    "            result = result + SPLIT_VALID + (value and SPLIT or 0)\n"
+    "        end\n"
+    "    end\n"
+    "    f = callbacks.isLoading\n"
+    "    if type(f) == 'function' then\n"
+    "        local value = f()\n"
+    "        if valid('isLoading', value, 'boolean') then\n"
+    "            result = result + LOADING_VALID + (value and LOADING or 0)\n"
+    "        end\n"
+    "    end\n"
+    "    f = callbacks.reset\n"
+    "    if type(f) == 'function' then\n"
+    "        local value = f()\n"
+    "        if valid('reset', value, 'boolean') and value then\n"
+    "            result = result + RESET\n"
+    "        end\n"
+    "    end\n"
+    "    return result, game_time\n"
+    "end\n";
+
+/**
+ * Installs the tick driver, calling all the tick callbacks in a single lua_pcall.
+ *
+ * The driver reads the callbacks on every tick, so they can be redefined at
+ * any time.
+ *
+ * @param L The Lua State
+ *
+ * @return True if the driver can be used.
+ */
+bool dispatch_installDriver(lua_State* L)
+{
+    if (luaL_loadbuffer(L, driver_source, sizeof(driver_source) - 1, "=__lasr_tick") != LUA_OK) {
+        printf("[dispatch] Can't load the tick driver: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1); // Remove the error message from the stack
+        return false;
+    }
+
+    static const unsigned constants[] = {
+        DISPATCH_RUN_STARTED,
+        DISPATCH_RUN_FINISHED,
+        DISPATCH_USE_GAME_TIME,
+        DISPATCH_START_VALID,
+        DISPATCH_START,
+        DISPATCH_SPLIT_VALID,
+        DISPATCH_SPLIT,
+        DISPATCH_RESET,
+        DISPATCH_LOADING_VALID,
+        DISPATCH_LOADING,
+        DISPATCH_GAME_TIME_VALID,
+    };
+    const int count = sizeof(constants) / sizeof(constants[0]);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, callbacks_table_ref);
+    for (int i = 0; i < count; i++) {
+        lua_pushinteger(L, constants[i]);
+    }
+    if (lua_pcall(L, 1 + count, 1, 0) != LUA_OK) {
+        printf("[dispatch] Can't create the tick driver: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1); // Remove the error message from the stack
+        return false;
+    }
+    driver_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return true;
+}
+
+/**
+ * Runs all the tick callbacks through the tick driver.
+ *
+ * @param L The Lua State
+ * @param flags DispatchFlag values describing the state of the run.
+ * @param[out] result What the callbacks returned.
+ *
+ * @return True if the callbacks ran without errors.
+ */
+bool dispatch_tick(lua_State* L, unsigned flags, DispatchResult* result)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, driver_ref);
+    lua_pushinteger(L, flags);
+    if (lua_pcall(L, 1, 2, 0) != LUA_OK) {
+        printf("error running function '__lasr_tick': %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1); // Remove the error message from the stack
+        return false;
+    }
+    result->flags = lua_tointeger(L, -2);
+    result->game_time = lua_tointeger(L, -1);
+    lua_pop(L, 2); // Remove the results from the stack
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <lua.h>
+#include <stdbool.h>
+
+/**
+ * The auto splitter callbacks that can run on every tick.
+ */
+typedef enum LasrCallback {
+    LASR_CALLBACK_STATE, /*!< state() */
+    LASR_CALLBACK_UPDATE, /*!< update() */
+    LASR_CALLBACK_GAME_TIME, /*!< gameTime() */
+    LASR_CALLBACK_START, /*!< start() */
+    LASR_CALLBACK_SPLIT, /*!< split() */
+    LASR_CALLBACK_IS_LOADING, /*!< isLoading() */
+    LASR_CALLBACK_RESET, /*!< reset() */
+    LASR_CALLBACK_COUNT,
+} LasrCallback;
+
+/**
+ * The state of the run, passed to the tick driver to choose the callbacks to call.
+ */
+typedef enum DispatchFlag {
+    DISPATCH_RUN_STARTED = 1 << 0, /*!< The run is started, so split() is called instead of start() */
+    DISPATCH_RUN_FINISHED = 1 << 1, /*!< The run is finished, so neither start() nor gameTime() are called */
+    DISPATCH_USE_GAME_TIME = 1 << 2, /*!< The game time is used, so gameTime() is called during runs */
+} DispatchFlag;
+
+/**
+ * What the callbacks returned during a tick run by the tick driver.
+ */
+typedef enum DispatchResultFlag {
+    DISPATCH_START_VALID = 1 << 0, /*!< start() returned a boolean */
+    DISPATCH_START = 1 << 1, /*!< start() returned true */
+    DISPATCH_SPLIT_VALID = 1 << 2, /*!< split() returned a boolean */
+    DISPATCH_SPLIT = 1 << 3, /*!< split() returned true */
+    DISPATCH_RESET = 1 << 4, /*!< reset() returned true */
+    DISPATCH_LOADING_VALID = 1 << 5, /*!< isLoading() returned a boolean */
+    DISPATCH_LOADING = 1 << 6, /*!< isLoading() returned true */
+    DISPATCH_GAME_TIME_VALID = 1 << 7, /*!< gameTime() returned a number */
+} DispatchResultFlag;
+
+/**
+ * The packed results of a tick run by the tick driver.
+ */
+typedef struct DispatchResult {
+    unsigned flags; /*!< DispatchResultFlag values */
+    int game_time; /*!< The value returned by gameTime(), if DISPATCH_GAME_TIME_VALID is set */
+} DispatchResult;
+
+extern const char* lasr_callback_names[LASR_CALLBACK_COUNT];
+
+void dispatch_watchCallbacks(lua_State* L);
+void dispatch_release(lua_State* L);
+void dispatch_refresh(lua_State* L);
+bool dispatch_has(LasrCallback callback);
+bool dispatch_call(lua_State* L, LasrCallback callback, int results);
+bool dispatch_callBoolean(lua_State* L, LasrCallback callback, bool* result);
+bool dispatch_callInteger(lua_State* L, LasrCallback callback, int* result);
+bool dispatch_installDriver(lua_State* L);
+bool dispatch_tick(lua_State* L, unsigned flags, DispatchResult* result);
@@ -1,13 +1,18 @@
 #pragma once
 
+#include "functions/addressToModule.h"
 #include "functions/bitwise.h"
+#include "functions/compileRead.h"
 #include "functions/getBaseAddress.h"
 #include "functions/getMaps.h"
 #include "functions/getModuleSize.h"
 #include "functions/getPID.h"
+#include "functions/getTickStats.h"
 #include "functions/print_tbl.h"
 #include "functions/process.h"
 #include "functions/readAddress.h"
+#include "functions/readBatch.h"
 #include "functions/shallow_copy_tbl.h"
 #include "functions/signature.h"
 #include "functions/sizeOf.h"
+#include "functions/watch.h"
@@ -0,0 +1,38 @@
+#include "addressToModule.h"
+
+#include "../maps/maps.h"
+#include "../memory/int64.h"
+#include "../utils.h"
+
+#include <stdio.h>
+
+/**
+ * The Lua "addressToModule" Auto Splitter function.
+ *
+ * Takes an absolute address and returns the name of the module it belongs
+ * to, along with the offset of the address from the base of that module.
+ * Returns nil if the address isn't inside a module backed by a file.
+ *
+ * @param L The Lua State
+ *
+ * @return The number of values pushed on the stack: 2 on success, 1 (nil) otherwise
+ */
+int addressToModule(lua_State* L)
+{
+    uint64_t address;
+    if (!int64_get(L, 1, &address)) {
+        printf("[addressToModule] Address must be a number or a 64-bit integer: %s\n", value_to_c_string(L, 1));
+        lua_pushnil(L);
+        return 1;
+    }
+
+    maps_update();
+    ProcessMap module;
+    if (!maps_findModuleOf(address, &module)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushstring(L, module.name);
+    lua_pushinteger(L, address - module.start);
+    return 2;
+}
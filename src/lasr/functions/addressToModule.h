@@ -0,0 +1,5 @@
+#pragma once
+
+#include <lua.h>
+
+int addressToModule(lua_State* L);
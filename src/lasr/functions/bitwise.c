@@ -1,10 +1,14 @@
 #include "bitwise.h"
 
+#include "../memory/int64.h"
+
 #include <stdio.h>
 
 /**
  * Performs a binary "and" operation between two integers.
  *
+ * If either integer is a 64-bit integer, so is the result.
+ *
  * @param L the Lua state.
  */
 int b_and(lua_State* L)
@@ -15,6 +19,11 @@ int b_and(lua_State* L)
         return 0;
     }
 
+    if (int64_isBoxed(L, 1) || int64_isBoxed(L, 2)) {
+        // 64-bit integers keep all their bits through LuaJIT's bit library
+        return int64_call(L, "b_and", "band");
+    }
+
     if (!lua_isnumber(L, 1) || !lua_isnumber(L, 2)) {
         // Arguments are not numbers
         printf("[b_and] Both arguments must be integers");
@@ -33,6 +42,8 @@ int b_and(lua_State* L)
 /**
  * Performs a binary "or" operation between two integers.
  *
+ * If either integer is a 64-bit integer, so is the result.
+ *
  * @param L the Lua state.
  */
 int b_or(lua_State* L)
@@ -43,6 +54,11 @@ int b_or(lua_State* L)
         return 0;
     }
 
+    if (int64_isBoxed(L, 1) || int64_isBoxed(L, 2)) {
+        // 64-bit integers keep all their bits through LuaJIT's bit library
+        return int64_call(L, "b_or", "bor");
+    }
+
     if (!lua_isnumber(L, 1) || !lua_isnumber(L, 2)) {
         // Arguments are not numbers
         printf("[b_or] Both arguments must be integers");
@@ -61,6 +77,8 @@ int b_or(lua_State* L)
 /**
  * Performs a binary "xor" operation between two integers.
  *
+ * If either integer is a 64-bit integer, so is the result.
+ *
  * @param L the Lua state.
  */
 int b_xor(lua_State* L)
@@ -71,6 +89,11 @@ int b_xor(lua_State* L)
         return 0;
     }
 
+    if (int64_isBoxed(L, 1) || int64_isBoxed(L, 2)) {
+        // 64-bit integers keep all their bits through LuaJIT's bit library
+        return int64_call(L, "b_xor", "bxor");
+    }
+
     if (!lua_isnumber(L, 1) || !lua_isnumber(L, 2)) {
         // Arguments are not numbers
         printf("[b_xor] Both arguments must be integers");
@@ -89,6 +112,8 @@ int b_xor(lua_State* L)
 /**
  * Performs a binary "not" operation on a single integer.
  *
+ * If the integer is a 64-bit integer, so is the result.
+ *
  * @param L the Lua state.
  */
 int b_not(lua_State* L)
@@ -99,6 +124,11 @@ int b_not(lua_State* L)
         return 0;
     }
 
+    if (int64_isBoxed(L, 1)) {
+        // 64-bit integers keep all their bits through LuaJIT's bit library
+        return int64_call(L, "b_not", "bnot");
+    }
+
     if (!lua_isnumber(L, 1)) {
         // Argument is not number
         printf("[b_not] The argument must be an integer");
@@ -116,6 +146,8 @@ int b_not(lua_State* L)
 /**
  * Performs a binary "left shift" operation on an integer.
  *
+ * If the integer is a 64-bit integer, so is the result.
+ *
  * @param L the Lua state.
  */
 int b_lshift(lua_State* L)
@@ -126,6 +158,11 @@ int b_lshift(lua_State* L)
         return 0;
     }
 
+    if (int64_isBoxed(L, 1) || int64_isBoxed(L, 2)) {
+        // 64-bit integers keep all their bits through LuaJIT's bit library
+        return int64_call(L, "b_lshift", "lshift");
+    }
+
     if (!lua_isnumber(L, 1) || !lua_isnumber(L, 2)) {
         // Arguments are not numbers
         printf("[b_lshift] Both arguments must be integers");
@@ -144,6 +181,8 @@ int b_lshift(lua_State* L)
 /**
  * Performs a binary "right shift" operation on an integer.
  *
+ * If the integer is a 64-bit integer, so is the result.
+ *
  * @param L the Lua state.
  */
 int b_rshift(lua_State* L)
@@ -154,6 +193,11 @@ int b_rshift(lua_State* L)
         return 0;
     }
 
+    if (int64_isBoxed(L, 1) || int64_isBoxed(L, 2)) {
+        // 64-bit integers keep all their bits through LuaJIT's bit library
+        return int64_call(L, "b_rshift", "rshift");
+    }
+
     if (!lua_isnumber(L, 1) || !lua_isnumber(L, 2)) {
         // Arguments are not numbers
         printf("[b_rshift] Both arguments must be integers");
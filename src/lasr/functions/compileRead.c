@@ -0,0 +1,185 @@
+#include "compileRead.h"
+
+#include "../maps/maps.h"
+#include "../memory/int64.h"
+#include "../memory/read_plan.h"
+#include "../utils.h"
+
+#include <lauxlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define COMPILED_READ_METATABLE "LASR.CompiledRead"
+
+/**
+ * A readAddress call with everything resolved ahead of time.
+ *
+ * The offsets, the value buffer and the module name are stored in the same
+ * userdata allocation, right after the structure.
+ */
+typedef struct CompiledRead {
+    ReadType type; /*!< The pre-parsed value type */
+    const char* module; /*!< The module name, NULL to use the main process */
+    int64_t base_offset; /*!< The offset to add to the module base address */
+    uintptr_t base; /*!< The cached module base address, 0 if it has to be resolved */
+    unsigned int generation; /*!< The maps generation `base` was resolved in */
+    int offsets_count; /*!< The number of pointer offsets */
+    int64_t* offsets; /*!< The pointer offsets */
+    void* value; /*!< Buffer the value is read into */
+} CompiledRead;
+
+/**
+ * Resolves the base address of the module used by a compiled read.
+ *
+ * @param read The compiled read.
+ *
+ * @return The base address, or 0 if the module could not be found.
+ */
+static uintptr_t compiled_read_base(CompiledRead* read)
+{
+    if (!read->module) {
+        return process.base_address;
+    }
+    if (read->base == 0 || read->generation != maps_getGeneration()) {
+        read->base = find_base_address(read->module);
+        // Resolving can rebuild the maps cache, take the generation afterwards
+        read->generation = maps_getGeneration();
+    }
+    return read->base;
+}
+
+/**
+ * The __call metamethod of compiled reads.
+ *
+ * Walks the pointer path and pushes the value read, or nil on failure.
+ *
+ * @param L The Lua state.
+ *
+ * @return Always 1.
+ */
+static int compiled_read_call(lua_State* L)
+{
+    CompiledRead* read = luaL_checkudata(L, 1, COMPILED_READ_METATABLE);
+
+    uintptr_t base = compiled_read_base(read);
+    if (base == 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    ReadChain chain = {
+        .address = base + read->base_offset,
+        .offsets = read->offsets,
+        .offsets_count = read->offsets_count,
+        .type = read->type,
+        .value = read->value,
+    };
+    readplan_execute(&chain, 1);
+
+    if (chain.error != 0) {
+        // The module might have moved, resolve it again on the next call
+        read->base = 0;
+        handle_memory_error(chain.error);
+        lua_pushnil(L);
+        return 1;
+    }
+
+    readplan_pushValue(L, &read->type, read->value);
+    return 1;
+}
+
+/**
+ * The __tostring metamethod of compiled reads.
+ *
+ * @param L The Lua state.
+ *
+ * @return Always 1.
+ */
+static int compiled_read_tostring(lua_State* L)
+{
+    CompiledRead* read = luaL_checkudata(L, 1, COMPILED_READ_METATABLE);
+    lua_pushfstring(L, "compiledRead(%s+%p, %d offsets)", read->module ? read->module : process.name, (void*)(intptr_t)read->base_offset, read->offsets_count);
+    return 1;
+}
+
+/**
+ * The Lua "compileRead" Auto Splitter function.
+ *
+ * Takes the same arguments as readAddress and returns a callable object that
+ * performs the read. The type string, module and offsets are only parsed once,
+ * and the module base address is cached until the process memory layout changes.
+ *
+ * @param L The Lua state.
+ *
+ * @return Always 1 (the compiled read, or nil on invalid arguments).
+ */
+int compileRead(lua_State* L)
+{
+    int top = lua_gettop(L);
+    if (top < 2 || !lua_isstring(L, 1) || lua_isnil(L, 2)) {
+        printf("[compileRead] At least two arguments are required: type and address. Check your auto splitter code.\n");
+        lua_pushnil(L);
+        return 1;
+    }
+
+    ReadType type;
+    if (!readplan_parseType(lua_tostring(L, 1), &type)) {
+        printf("[compileRead] Invalid value type: %s\n", lua_tostring(L, 1));
+        lua_pushnil(L);
+        return 1;
+    }
+
+    const char* module = NULL;
+    int first_offset = 3;
+    if (lua_type(L, 2) == LUA_TSTRING && !lua_isnumber(L, 2)) {
+        module = lua_tostring(L, 2);
+        if (strcmp(module, process.name) == 0) {
+            module = NULL;
+        }
+        first_offset = 4;
+    }
+
+    int invalid = int64_findInvalid(L, first_offset - 1, top);
+    if (invalid) {
+        printf("[compileRead] Argument %d is not a valid address or offset: %s\n", invalid, value_to_c_string(L, invalid));
+        lua_pushnil(L);
+        return 1;
+    }
+
+    int offsets_count = top >= first_offset ? top - first_offset + 1 : 0;
+    size_t module_size = module ? strlen(module) + 1 : 0;
+    size_t value_size = (type.size + 7) & ~(size_t)7;
+    CompiledRead* read = lua_newuserdata(L, sizeof(CompiledRead) + offsets_count * sizeof(int64_t) + value_size + module_size);
+
+    read->type = type;
+    uint64_t offset;
+    int64_get(L, first_offset - 1, &offset);
+    read->base_offset = offset;
+    read->base = 0;
+    read->generation = 0;
+    read->offsets_count = offsets_count;
+    read->offsets = (int64_t*)(read + 1);
+    for (int i = 0; i < offsets_count; i++) {
+        int64_get(L, first_offset + i, &offset);
+        read->offsets[i] = offset;
+    }
+    read->value = read->offsets + offsets_count;
+    read->module = NULL;
+    if (module) {
+        char* module_copy = (char*)read->value + value_size;
+        memcpy(module_copy, module, module_size);
+        read->module = module_copy;
+    }
+
+    if (luaL_newmetatable(L, COMPILED_READ_METATABLE)) {
+        lua_pushcfunction(L, compiled_read_call);
+        lua_setfield(L, -2, "__call");
+        lua_pushcfunction(L, compiled_read_tostring);
+        lua_setfield(L, -2, "__tostring");
+        // Hide the metatable from scripts
+        lua_pushboolean(L, 0);
+        lua_setfield(L, -2, "__metatable");
+    }
+    lua_setmetatable(L, -2);
+    return 1;
+}
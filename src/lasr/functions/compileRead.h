@@ -0,0 +1,5 @@
+#pragma once
+
+#include <lua.h>
+
+int compileRead(lua_State* L);
@@ -16,17 +16,15 @@ int getMaps(lua_State* L)
         lua_pushnil(L);
         return 1;
     }
-    if (maps_cache == NULL) {
-        // Whoops, cache is not filled yet, let's do it now
-        maps_getAll();
-    }
+    // Fill the cache if it is empty or outdated
+    maps_update();
     // Create a table, in "array mode", maps_cache_size big
     lua_createtable(L, maps_cache_size, 0);
     // Stack: array
     for (uint32_t i = 0; i < maps_cache_size; i++) {
         ProcessMap map = maps_cache[i];
-        // Create a new table with 4 non-array fields
-        lua_createtable(L, 0, 4);
+        // Create a new table with 5 non-array fields
+        lua_createtable(L, 0, 5);
         // Stack: array, table
         // Push "name" onto the stack
         lua_pushstring(L, map.name);
@@ -44,6 +42,9 @@ int getMaps(lua_State* L)
         // Push "size"
         lua_pushnumber(L, map.size);
         lua_setfield(L, -2, "size");
+        // Push "perms"
+        lua_pushstring(L, map.perms);
+        lua_setfield(L, -2, "perms");
 
         // Stack: Array, Table, [TopOfStack]
         // Assign the table on top of the stack as the i-th element of
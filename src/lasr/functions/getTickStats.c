@@ -0,0 +1,53 @@
+#include "getTickStats.h"
+
+#include "../heap/heap.h"
+#include "../memory/arena.h"
+#include "../scheduler/scheduler.h"
+
+/**
+ * The Lua "getTickStats" Auto Splitter function.
+ *
+ * Returns a table with the timing statistics of the ticks so far: `ticks`,
+ * `overruns` (deadlines missed because ticks took too long), `maxJitter`
+ * (the latest a tick started after its deadline, in microseconds) and
+ * `jitter`, an array where the element `i` counts the ticks that started
+ * less than 2^(i-1) microseconds late, the last element counting the others.
+ * `arenaBytes` and `arenaCapacity` are the most memory the LASR functions
+ * used from their arena during the last tick and the memory it holds, in bytes.
+ * `luaBytes` is the size of the Lua heap, `luaAllocated` the bytes Lua
+ * allocated during the last tick and `memoryLimit` the most the heap may
+ * grow to, in bytes, 0 if unlimited.
+ *
+ * @param L The Lua State
+ *
+ * @return Always 1 (the table)
+ */
+int getTickStats(lua_State* L)
+{
+    lua_createtable(L, 0, 9);
+    lua_pushnumber(L, tick_scheduler.ticks);
+    lua_setfield(L, -2, "ticks");
+    lua_pushnumber(L, tick_scheduler.overruns);
+    lua_setfield(L, -2, "overruns");
+    lua_pushnumber(L, tick_scheduler.max_jitter_ns / 1000);
+    lua_setfield(L, -2, "maxJitter");
+    lua_pushnumber(L, arena_stats.tick_peak);
+    lua_setfield(L, -2, "arenaBytes");
+    lua_pushnumber(L, arena_stats.capacity);
+    lua_setfield(L, -2, "arenaCapacity");
+    lua_Number heap_kb = lua_gc(L, LUA_GCCOUNT, 0);
+    lua_pushnumber(L, heap_kb * 1024 + lua_gc(L, LUA_GCCOUNTB, 0));
+    lua_setfield(L, -2, "luaBytes");
+    lua_pushnumber(L, heap_stats.tick_allocated);
+    lua_setfield(L, -2, "luaAllocated");
+    lua_pushnumber(L, heap_stats.active ? heap_stats.limit : 0);
+    lua_setfield(L, -2, "memoryLimit");
+
+    lua_createtable(L, SCHEDULER_JITTER_BUCKETS, 0);
+    for (int i = 0; i < SCHEDULER_JITTER_BUCKETS; i++) {
+        lua_pushnumber(L, tick_scheduler.jitter[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "jitter");
+    return 1;
+}
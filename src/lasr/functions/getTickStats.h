@@ -0,0 +1,5 @@
+#pragma once
+
+#include <lua.h>
+
+int getTickStats(lua_State* L);
@@ -1,98 +1,97 @@
 #include "process.h"
 
+#include "../process/discovery.h"
+#include "../process/handle.h"
+#include "../process/image.h"
 #include "../utils.h"
 
+#include <linux/limits.h>
 #include <stdatomic.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
 extern atomic_bool auto_splitter_enabled; /*!< Defines if the auto splitter is enabled */
 
 /**
- * Executes a command, piping its output into an output string.
+ * Waits for the process and stores its PID, base address and pointer size.
  *
- * @param command The command to execute.
- * @param output Pointer to a string that will contain the command output.
+ * @param pick Which process to use when several match.
  */
-void execute_command(const char* command, char* output)
+static void stock_process_id(DiscoveryPick pick)
 {
-    char buffer[4096];
-    FILE* pipe = popen(command, "r");
-    if (!pipe) {
-        fprintf(stderr, "Error executing command: %s\n", command);
-        exit(1);
-    }
-
-    while (fgets(buffer, 128, pipe) != NULL) {
-        strcat(output, buffer);
-    }
-
-    pclose(pipe);
-}
-
-void stock_process_id(const char* pid_command)
-{
-    char pid_output[PATH_MAX + 100];
-    pid_output[0] = '\0';
-
-    while (atomic_load(&auto_splitter_enabled)) {
-        execute_command(pid_command, pid_output);
-        process.pid = strtoul(pid_output, NULL, 10);
-        if (process.pid) {
-            size_t newlinePos = strcspn(pid_output, "\n");
-            if (newlinePos != strlen(pid_output) - 1 && pid_output[0] != '\0') {
-                printf("Multiple PID's found for process: %s\n", process.name);
-            }
+    size_t count = 0;
+    for (;;) {
+        pid_t pid = discovery_wait(process.name, pick, &auto_splitter_enabled, &count);
+        if (!pid) {
+            process_detach();
+            break;
+        }
+        // The PID may have been reused between the scan and opening the pidfd
+        if (process_attach(pid) && discovery_matches(pid, process.name)) {
             break;
-        } else {
-            printf("%s isn't running.\n", process.name);
-            usleep(100000); // Sleep for 100ms
         }
+        process_detach();
+    }
+    if (count > 1) {
+        printf("Multiple PID's found for process: %s\n", process.name);
     }
 
     printf("Process: %s\n", process.name);
     printf("PID: %u\n", process.pid);
     process.base_address = find_base_address(NULL);
     process.dll_address = process.base_address;
+    process.pointer_size = image_pointerSize(process.base_address);
+    if (process.pointer_size) {
+        printf("Pointer size: %u bytes\n", process.pointer_size);
+    } else {
+        printf("Pointer size: unknown, guessed from every address\n");
+    }
 }
 
+/**
+ * The name of the process, copied since the string passed by the auto
+ * splitter is collected when the auto splitter is reloaded.
+ */
+static char process_name[PATH_MAX];
+
 /**
  * Finds the ID of the process indicated by the Lua Auto Splitter.
  *
+ * When a reloaded auto splitter asks for the process it was already attached
+ * to, the process is kept as is.
+ *
  * @param L The Lua State.
  *
  * @return Always zero.
  */
 int find_process_id(lua_State* L)
 {
+    const char* name = lua_tostring(L, 1);
+    if (name && process.name && strcmp(name, process.name) == 0 && process_isRunning()) {
+        printf("Process: %s, PID %u, kept\n", process.name, process.pid);
+        return 0;
+    }
+
     printf("\033[2J\033[1;1H"); // Clear the console
 
-    process.name = lua_tostring(L, 1);
+    if (name) {
+        snprintf(process_name, sizeof(process_name), "%s", name);
+        process.name = process_name;
+    } else {
+        process.name = NULL;
+    }
     const char* sort = lua_tostring(L, 2);
-    char sortCmd[16] = "";
+    DiscoveryPick pick = DISCOVERY_PICK_FIRST;
 
-    if (!sort) {
-        sort = "first";
-    } else {
-        if (strcmp(sort, "first") != 0 && strcmp(sort, "last") != 0) {
+    if (sort) {
+        if (strcmp(sort, "last") == 0) {
+            pick = DISCOVERY_PICK_LAST; // Latest PID
+        } else if (strcmp(sort, "first") != 0) {
             printf("[process] Invalid sort argument '%s'. Use 'first' or 'last'. Falling back to first\n", sort);
-            sort = "first";
         }
     }
 
-    if (strcmp(sort, "first") == 0) {
-        sortCmd[0] = '\0'; // No sorting
-    }
-    if (strcmp(sort, "last") == 0) {
-        strcpy(sortCmd, " | sort -r"); // Reverse the sorting to get latest PID
-    }
-
-    char command[256];
-    snprintf(command, sizeof(command), "pgrep \"%.*s\"%s", (int)strnlen(process.name, sizeof(command) - strlen(sortCmd) - 1), process.name, sortCmd);
-
-    stock_process_id(command);
+    stock_process_id(pick);
 
     return 0;
 }
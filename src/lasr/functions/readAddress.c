@@ -1,4 +1,8 @@
 #include "readAddress.h"
+#include "../memory/arena.h"
+#include "../memory/int64.h"
+#include "../memory/read.h"
+#include "../memory/read_plan.h"
 #include "../utils.h"
 
 #include <errno.h>
@@ -30,7 +34,7 @@ bool memory_error = false;
         mem_remote.iov_len = sizeof(value);                                                      \
         mem_remote.iov_base = (void*)(uintptr_t)mem_address;                                     \
                                                                                                  \
-        ssize_t mem_n_read = process_vm_readv(process.pid, &mem_local, 1, &mem_remote, 1, 0);    \
+        ssize_t mem_n_read = memory_readv(process.pid, &mem_local, 1, &mem_remote, 1);           \
         if (mem_n_read == -1) {                                                                  \
             *err = (int32_t)errno;                                                               \
             memory_error = true;                                                                 \
@@ -54,41 +58,69 @@ READ_MEMORY_FUNCTION(double)
 READ_MEMORY_FUNCTION(bool)
 
 /**
- * Reads an address from memory and interprets it as a string.
+ * Reads a value of any size from memory with a single syscall.
  *
  * @param mem_address The memory address to read from.
- * @param buffer_size The size of the buffer to allocate.
+ * @param buffer Where to store the bytes.
+ * @param size The number of bytes to read.
  * @param err A pointer to an error flag to write to.
- *
- * @return The string read from memory.
  */
-char* read_memory_string(uint64_t mem_address, int buffer_size, int32_t* err)
+static void read_memory_value(uint64_t mem_address, void* buffer, size_t size, int32_t* err)
 {
-    char* buffer = (char*)malloc(buffer_size);
-    if (buffer == NULL) {
-        // Handle memory allocation failure
-        return NULL;
+    struct iovec mem_local = { .iov_base = buffer, .iov_len = size };
+    struct iovec mem_remote = { .iov_base = (void*)(uintptr_t)mem_address, .iov_len = size };
+    ssize_t mem_n_read = memory_readv(process.pid, &mem_local, 1, &mem_remote, 1);
+    if (mem_n_read == -1) {
+        *err = (int32_t)errno;
+        memory_error = true;
+    } else if (mem_n_read != (ssize_t)size) {
+        // The value runs into unreadable memory
+        *err = EFAULT;
+        memory_error = true;
     }
+}
 
-    struct iovec mem_local;
-    struct iovec mem_remote;
+/**
+ * Reads a pointer stored in the game memory.
+ */
+typedef uint64_t (*PointerReader)(uint64_t mem_address, int32_t* err);
 
-    mem_local.iov_base = buffer;
-    mem_local.iov_len = buffer_size;
-    mem_remote.iov_len = buffer_size;
-    mem_remote.iov_base = (void*)(uintptr_t)mem_address;
+/**
+ * Reads a 32 bit pointer.
+ */
+static uint64_t read_pointer_32(uint64_t mem_address, int32_t* err)
+{
+    return read_memory_uint32_t(mem_address, err);
+}
 
-    ssize_t mem_n_read = process_vm_readv(process.pid, &mem_local, 1, &mem_remote, 1, 0);
-    if (mem_n_read == -1) {
-        buffer[0] = '\0';
-        *err = (int32_t)errno;
-        memory_error = true;
-    } else if (mem_n_read != (ssize_t)mem_remote.iov_len) {
-        printf("Error reading process memory: short read of %ld bytes\n", (long)mem_n_read);
-        exit(1);
+/**
+ * Reads a pointer whose width is guessed from its address, for processes
+ * whose pointer size is unknown: addresses that fit in 32 bits are assumed to
+ * belong to a 32 bit process.
+ */
+static uint64_t read_pointer_guessed(uint64_t mem_address, int32_t* err)
+{
+    if (mem_address <= UINT32_MAX) {
+        return read_memory_uint32_t(mem_address, err);
     }
+    return read_memory_uint64_t(mem_address, err);
+}
 
-    return buffer;
+/**
+ * Chooses how to read the pointers of the game, once per pointer path.
+ *
+ * @return The pointer reader for the pointer size of the process.
+ */
+static PointerReader pointer_reader(void)
+{
+    switch (process.pointer_size) {
+        case sizeof(uint32_t):
+            return read_pointer_32;
+        case sizeof(uint64_t):
+            return read_memory_uint64_t;
+        default:
+            return read_pointer_guessed;
+    }
 }
 
 /**
@@ -115,6 +147,12 @@ int readAddress(lua_State* L)
     const char* value_type = lua_tostring(L, 1);
     int i;
 
+    ReadType type;
+    if (!readplan_parseType(value_type, &type)) {
+        printf("[readAddress] Invalid value type: %s, please read documentation\n", value_type);
+        exit(1);
+    }
+
     if (lua_isnil(L, 2)) {
         // The address is NULL, this will bring a segfault if left alone
         printf("[readAddress] The address argument cannot be nil. Check your auto splitter code.\n");
@@ -122,110 +160,53 @@ int readAddress(lua_State* L)
         return 1;
     }
 
-    if (lua_isnumber(L, 2)) {
-        address = process.base_address + lua_tointeger(L, 2);
+    int first_offset = lua_type(L, 2) == LUA_TSTRING && !lua_isnumber(L, 2) ? 3 : 2;
+    int invalid = int64_findInvalid(L, first_offset, lua_gettop(L));
+    if (invalid) {
+        printf("[readAddress] Argument %d is not a valid address or offset: %s\n", invalid, value_to_c_string(L, invalid));
+        lua_pushnil(L);
+        return 1;
+    }
+
+    uint64_t offset;
+    if (int64_get(L, 2, &offset)) {
+        address = process.base_address + offset;
         i = 3;
     } else {
         const char* module = lua_tostring(L, 2);
         if (strcmp(process.name, module) != 0) {
             process.dll_address = find_base_address(module);
         }
-        address = process.dll_address + lua_tointeger(L, 3);
+        int64_get(L, 3, &offset);
+        address = process.dll_address + offset;
         i = 4;
     }
 
     int error = 0;
 
+    PointerReader read_pointer = pointer_reader();
     for (; i <= lua_gettop(L); i++) {
-        if (address <= UINT32_MAX) {
-            address = read_memory_uint32_t((uint64_t)address, &error);
-            if (memory_error)
-                break;
-        } else {
-            address = read_memory_uint64_t(address, &error);
-            if (memory_error)
-                break;
-        }
-        address += lua_tointeger(L, i);
+        address = read_pointer(address, &error);
+        if (memory_error)
+            break;
+        int64_get(L, i, &offset);
+        address += offset;
     }
 
-    if (strcmp(value_type, "sbyte") == 0) {
-        int8_t value = read_memory_int8_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "byte") == 0) {
-        uint8_t value = read_memory_uint8_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "short") == 0) {
-        int16_t value = read_memory_int16_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "ushort") == 0) {
-        uint16_t value = read_memory_uint16_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "int") == 0) {
-        int32_t value = read_memory_int32_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "uint") == 0) {
-        uint32_t value = read_memory_uint32_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "long") == 0) {
-        // TODO: Fix 64 bit numbers, luajit 5.1 doesnt support 64 bit numbers natively
-        int64_t value = read_memory_int64_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "ulong") == 0) {
-        // TODO: Fix 64 bit numbers, luajit 5.1 doesnt support 64 bit numbers natively
-        uint64_t value = read_memory_uint64_t(address, &error);
-        lua_pushinteger(L, value);
-    } else if (strcmp(value_type, "float") == 0) {
-        float value = read_memory_float(address, &error);
-        lua_pushnumber(L, value);
-    } else if (strcmp(value_type, "double") == 0) {
-        double value = read_memory_double(address, &error);
-        lua_pushnumber(L, value);
-    } else if (strcmp(value_type, "bool") == 0) {
-        bool value = read_memory_bool(address, &error);
-        lua_pushboolean(L, value ? 1 : 0);
-    } else if (strstr(value_type, "string") != NULL) {
-        int buffer_size = atoi(value_type + 6);
-        if (buffer_size < 2) {
-            printf("[readAddress] Invalid string size, please read documentation");
-            exit(1);
-        }
-        char* value = read_memory_string(address, buffer_size, &error);
-        lua_pushstring(L, value != NULL ? value : "");
-        free(value);
-    } else if (strstr(value_type, "byte")) {
-        int array_size = atoi(value_type + 4);
-        if (array_size < 1) {
-            printf("[readAddress] Invalid byte array size, please read documentation");
-            exit(1);
-        }
-        uint8_t* results = malloc(array_size * sizeof(uint8_t));
-        if (!results) {
-            printf("[readAddress] Memory allocation failed for byte array.\n");
-            exit(1);
+    if (!memory_error) {
+        ArenaMark mark = arena_mark();
+        void* value = arena_alloc(type.size);
+        if (!value) {
+            printf("[readAddress] Memory allocation failed for %s.\n", value_type);
+            arena_release(mark);
+            lua_pushnil(L);
+            return 1;
         }
-        for (int j = 0; j < array_size; j++) {
-            uint8_t value = read_memory_uint8_t(address + j, &error);
-            if (memory_error)
-                break;
-            results[j] = value;
-        }
-
-        // Now that we have the results, push them to Lua table
-        // This is because if the read_memory fails midway, we don't want to push partial data
-        // And also want to avoid pushing the fallback result as part of the table
+        read_memory_value(address, value, type.size, &error);
         if (!memory_error) {
-            lua_createtable(L, array_size, 0);
-            for (int j = 0; j < array_size; j++) {
-                uint8_t value = results[j];
-                lua_pushinteger(L, value);
-                lua_rawseti(L, -2, j + 1);
-            }
+            readplan_pushValue(L, &type, value);
         }
-        free(results);
-    } else {
-        printf("[readAddress] Invalid value type: %s\n", value_type);
-        exit(1);
+        arena_release(mark);
     }
 
     if (memory_error) {
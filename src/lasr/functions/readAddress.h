@@ -1,5 +1,19 @@
 #pragma once
 
 #include <lua.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+int8_t read_memory_int8_t(uint64_t mem_address, int32_t* err);
+uint8_t read_memory_uint8_t(uint64_t mem_address, int32_t* err);
+int16_t read_memory_int16_t(uint64_t mem_address, int32_t* err);
+uint16_t read_memory_uint16_t(uint64_t mem_address, int32_t* err);
+int32_t read_memory_int32_t(uint64_t mem_address, int32_t* err);
+uint32_t read_memory_uint32_t(uint64_t mem_address, int32_t* err);
+int64_t read_memory_int64_t(uint64_t mem_address, int32_t* err);
+uint64_t read_memory_uint64_t(uint64_t mem_address, int32_t* err);
+float read_memory_float(uint64_t mem_address, int32_t* err);
+double read_memory_double(uint64_t mem_address, int32_t* err);
+bool read_memory_bool(uint64_t mem_address, int32_t* err);
 
 int readAddress(lua_State* L);
\ No newline at end of file
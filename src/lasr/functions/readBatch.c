@@ -0,0 +1,182 @@
+#include "readBatch.h"
+
+#include "../memory/arena.h"
+#include "../memory/int64.h"
+#include "../memory/read_plan.h"
+#include "../utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Gets the address a readBatch entry starts from.
+ *
+ * @param L The Lua state.
+ * @param entry The stack index of the entry table.
+ * @param[out] address The starting address (base address plus first offset).
+ * @param[out] first_offset The table index of the first pointer offset.
+ *
+ * @return True if the entry points to a valid starting address and all its
+ * offsets are valid.
+ */
+static bool entry_start(lua_State* L, int entry, uint64_t* address, int* first_offset)
+{
+    bool valid = true;
+    uint64_t offset;
+    lua_rawgeti(L, entry, 2);
+    if (lua_type(L, -1) == LUA_TSTRING && !lua_isnumber(L, -1)) {
+        const char* module = lua_tostring(L, -1);
+        uintptr_t base = strcmp(process.name, module) == 0 ? process.base_address : find_base_address(module);
+        lua_rawgeti(L, entry, 3);
+        valid = base != 0 && int64_get(L, -1, &offset);
+        *address = base + offset;
+        *first_offset = 4;
+        lua_pop(L, 1);
+    } else {
+        valid = int64_get(L, -1, &offset);
+        *address = process.base_address + offset;
+        *first_offset = 3;
+    }
+    lua_pop(L, 1);
+
+    int length = lua_objlen(L, entry);
+    for (int i = *first_offset; valid && i <= length; i++) {
+        lua_rawgeti(L, entry, i);
+        valid = int64_get(L, -1, &offset);
+        lua_pop(L, 1);
+    }
+    return valid;
+}
+
+/**
+ * Parses the type of a readBatch entry.
+ *
+ * @param L The Lua state.
+ * @param entry The stack index of the entry table.
+ * @param[out] type The parsed type.
+ *
+ * @return True if the entry is a table with a valid type as first element.
+ */
+static bool entry_type(lua_State* L, int entry, ReadType* type)
+{
+    if (!lua_istable(L, entry)) {
+        return false;
+    }
+    lua_rawgeti(L, entry, 1);
+    bool valid = lua_type(L, -1) == LUA_TSTRING && readplan_parseType(lua_tostring(L, -1), type);
+    lua_pop(L, 1);
+    return valid;
+}
+
+/**
+ * The Lua "readBatch" Auto Splitter function.
+ *
+ * Takes a table of readAddress-like argument lists and reads all of them at once,
+ * resolving every pointer path level by level with one syscall per level.
+ *
+ * Returns a table with the same keys as the one passed, each holding the read value,
+ * or nil if that read failed.
+ *
+ * @param L The Lua state.
+ *
+ * @return Always 1.
+ */
+int readBatch(lua_State* L)
+{
+    if (lua_gettop(L) != 1 || !lua_istable(L, 1)) {
+        printf("[readBatch] A single table of reads is required. Check your auto splitter code.\n");
+        lua_pushnil(L);
+        return 1;
+    }
+
+    // First pass: count the entries, offsets and value bytes to allocate everything at once
+    size_t count = 0;
+    size_t offsets_total = 0;
+    size_t values_total = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0) {
+        ReadType type;
+        if (entry_type(L, -1, &type)) {
+            offsets_total += lua_objlen(L, -1);
+            // Keep every value 8-byte aligned
+            values_total += (type.size + 7) & ~(size_t)7;
+        }
+        count++;
+        lua_pop(L, 1);
+    }
+
+    ArenaMark mark = arena_mark();
+    ReadChain* chains = arena_calloc(count, sizeof(ReadChain));
+    bool* skipped = arena_calloc(count, sizeof(bool));
+    int64_t* offsets = arena_alloc(offsets_total * sizeof(int64_t) + 1);
+    uint8_t* values = arena_alloc(values_total + 1);
+    if (!chains || !skipped || !offsets || !values) {
+        printf("[readBatch] Memory allocation failed.\n");
+        arena_release(mark);
+        lua_pushnil(L);
+        return 1;
+    }
+
+    // Second pass: build the chains
+    size_t i = 0;
+    int64_t* next_offset = offsets;
+    uint8_t* next_value = values;
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0) {
+        ReadChain* chain = &chains[i];
+        int entry = lua_gettop(L);
+        int first_offset = 0;
+        if (!entry_type(L, entry, &chain->type) || !entry_start(L, entry, &chain->address, &first_offset)) {
+            // Print a copy of the key, lua_tostring would confuse lua_next otherwise
+            lua_pushvalue(L, entry - 1);
+            printf("[readBatch] Entry %s is not a valid readAddress argument list, skipping it.\n", value_to_c_string(L, -1));
+            lua_pop(L, 1);
+            // Skipped entries never get queued
+            chain->offsets_count = -1;
+            skipped[i++] = true;
+            lua_pop(L, 1);
+            continue;
+        }
+
+        int length = lua_objlen(L, entry);
+        chain->offsets = next_offset;
+        for (int j = first_offset; j <= length; j++) {
+            uint64_t offset;
+            lua_rawgeti(L, entry, j);
+            int64_get(L, -1, &offset);
+            *next_offset++ = offset;
+            lua_pop(L, 1);
+        }
+        chain->offsets_count = next_offset - chain->offsets;
+        chain->value = next_value;
+        next_value += (chain->type.size + 7) & ~(size_t)7;
+        i++;
+        lua_pop(L, 1);
+    }
+
+    readplan_execute(chains, count);
+
+    // Third pass: push the results with the same keys as the entries
+    lua_createtable(L, 0, count);
+    int results = lua_gettop(L);
+    i = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        if (!skipped[i] && chains[i].error == 0) {
+            readplan_pushValue(L, &chains[i].type, chains[i].value);
+        } else {
+            if (!skipped[i]) {
+                handle_memory_error(chains[i].error);
+            }
+            lua_pushnil(L);
+        }
+        lua_rawset(L, results);
+        i++;
+    }
+
+    arena_release(mark);
+    return 1;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <lua.h>
+
+int readBatch(lua_State* L);
@@ -1,9 +1,15 @@
 #include "signature.h"
 
+#include "../maps/maps.h"
+#include "../memory/arena.h"
+#include "../memory/int64.h"
+#include "../scan/cache.h"
+#include "../scan/multi.h"
+#include "../scan/parallel.h"
+#include "../scan/pattern.h"
 #include "../utils.h"
 
-#include <fcntl.h>
-#include <inttypes.h>
+#include <lauxlib.h>
 #include <lua.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -11,13 +17,6 @@
 #include <string.h>
 #include <unistd.h>
 
-// Error handling macro
-#define HANDLE_ERROR(msg) \
-    do {                  \
-        perror(msg);      \
-        return NULL;      \
-    } while (0)
-
 /**
  * Error logging function
  *
@@ -34,136 +33,138 @@ void log_error(const char* format, ...)
 }
 
 /**
- * Gets all the memory regions of a certain PID
+ * Reads an address field of the sig_scan options table.
  *
- * @param[in] pid The ID of the process to get the memory regions of
- * @param[in] count A pointer to a counter onto where to store the number of regions
+ * @param L The lua state.
+ * @param index The stack index of the options table.
+ * @param name The name of the field.
+ * @param[out] value The value of the field, left as is if the field is nil.
  *
- * @return A dinamically allocated array of ProcessMap that have been found
+ * @return False if the field is neither nil nor a valid address.
  */
-ProcessMap* get_memory_regions(pid_t pid, int* count)
+static bool read_address_option(lua_State* L, int index, const char* name, uint64_t* value)
 {
-    // TODO: Convert this function to use maps.c functions
-    char maps_path[256];
-    if (snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", pid) < 0) {
-        HANDLE_ERROR("Failed to create maps path");
+    lua_getfield(L, index, name);
+    uint64_t field;
+    bool valid = lua_isnil(L, -1) || int64_get(L, -1, &field);
+    if (!valid) {
+        log_error("Invalid %s option: %s", name, value_to_c_string(L, -1));
+    } else if (!lua_isnil(L, -1)) {
+        *value = field;
     }
-
-    FILE* maps_file = fopen(maps_path, "r");
-    if (!maps_file) {
-        HANDLE_ERROR("Failed to open maps file");
-    }
-
-    ProcessMap* regions = NULL;
-    int capacity = 0;
-    *count = 0;
-
-    char line[256];
-    while (fgets(line, sizeof(line), maps_file)) {
-        if (*count >= capacity) {
-            capacity = capacity == 0 ? 10 : capacity * 2;
-            ProcessMap* temp = realloc(regions, capacity * sizeof(ProcessMap));
-            if (!temp) {
-                free(regions);
-                fclose(maps_file);
-                HANDLE_ERROR("Failed to allocate memory for regions");
-            }
-            regions = temp;
-        }
-
-        uintptr_t start, end;
-        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR, &start, &end) != 2) {
-            continue; // Skip lines that don't match the expected format
-        }
-        regions[*count].start = start;
-        regions[*count].end = end;
-        (*count)++;
-    }
-
-    fclose(maps_file);
-    return regions;
+    lua_pop(L, 1);
+    return valid;
 }
 
 /**
- * Matches a pattern with an array of bytes.
+ * Reads the sig_scan options table into a maps filter.
+ *
+ * Supported fields are `module` (substring of the map name), `perms`
+ * (like "r-x"), `minAddress`, `maxAddress` and `maxRegionSize`.
  *
- * @param[in] data The data to compare the pattern against.
- * @param[in] pattern The pattern to test for.
- * @param[in] pattern_size The length of the pattern.
+ * @param L The lua state.
+ * @param index The stack index of the options table.
+ * @param[out] filter The filter to fill.
  *
- * @return True if the pattern matches the data, false otherwise
+ * @return False if an address option is invalid.
  */
-bool match_pattern(const uint8_t* data, const uint16_t* pattern, size_t pattern_size)
+static bool read_scan_options(lua_State* L, int index, MapsFilter* filter)
 {
-    for (size_t i = 0; i < pattern_size; ++i) {
-        uint8_t byte = pattern[i] & 0xFF;
-        bool ignore = (pattern[i] >> 8) & 0x1;
-        if (!ignore && data[i] != byte) {
-            return false;
-        }
+    lua_getfield(L, index, "module");
+    if (lua_type(L, -1) == LUA_TSTRING) {
+        filter->module = lua_tostring(L, -1);
+    }
+    lua_getfield(L, index, "perms");
+    if (lua_type(L, -1) == LUA_TSTRING) {
+        filter->perms = lua_tostring(L, -1);
+    }
+    // The strings stay referenced by the options table, so they can be popped
+    lua_pop(L, 2);
+
+    uint64_t min_address = filter->min_address;
+    uint64_t max_address = filter->max_address;
+    uint64_t max_size = filter->max_size;
+    if (!read_address_option(L, index, "minAddress", &min_address)
+        || !read_address_option(L, index, "maxAddress", &max_address)
+        || !read_address_option(L, index, "maxRegionSize", &max_size)) {
+        return false;
     }
+    filter->min_address = min_address;
+    filter->max_address = max_address;
+    filter->max_size = max_size;
     return true;
 }
 
 /**
- * Converts an IDA-like signature into a pattern to be used in LibreSplit.
- * Supports the '??' string to ignore certain bytes in the comparison.
+ * Finds the lowest match of each pattern in the regions selected by a filter,
+ * going through the signature cache.
  *
- * @param[in] signature A string containing the signature to convert.
- * @param[out] pattern_size A pointer onto where to save the size of the pattern.
+ * Patterns with a valid cached result are not scanned, the others are all
+ * scanned in a single pass and their matches are added to the cache.
  *
- * @return A pattern to be used with the LibreSplit signature scan functions.
+ * @param patterns The compiled signatures.
+ * @param keys The cache key of each pattern, NULL to bypass the cache.
+ * @param count The number of patterns.
+ * @param filter The filter of the regions to scan.
+ * @param[out] matches For each pattern, the address of its match.
+ * @param[out] found For each pattern, whether it was found.
+ *
+ * @return False if the scan couldn't be performed.
  */
-uint16_t* convert_signature(const char* signature, size_t* pattern_size)
+static bool find_signatures(const ScanPattern* patterns, char* const* keys, size_t count, const MapsFilter* filter, uintptr_t* matches, bool* found)
 {
-    char* signature_copy = strdup(signature);
-    if (!signature_copy) {
-        return NULL;
-    }
-
-    char* token = strtok(signature_copy, " ");
-    size_t size = 0;
-    size_t capacity = 10;
-    uint16_t* pattern = (uint16_t*)malloc(capacity * sizeof(uint16_t));
-    if (!pattern) {
-        free(signature_copy);
-        return NULL;
+    ScanPattern* pending = arena_alloc(count * sizeof(ScanPattern));
+    size_t* pending_index = arena_alloc(count * sizeof(size_t));
+    if (!pending || !pending_index) {
+        log_error("Out of memory");
+        return false;
     }
 
-    while (token != NULL) {
-        if (size >= capacity) {
-            capacity *= 2;
-            uint16_t* temp = (uint16_t*)realloc(pattern, capacity * sizeof(uint16_t));
-            if (!temp) {
-                free(pattern);
-                free(signature_copy);
-                return NULL;
-            }
-            pattern = temp;
+    size_t pending_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        found[i] = keys[i] && scan_cacheLookup(keys[i], &patterns[i], &matches[i]);
+        if (!found[i]) {
+            pending[pending_count] = patterns[i];
+            pending_index[pending_count] = i;
+            pending_count++;
         }
+    }
 
-        if (strstr(token, "?") != NULL) {
-            // Treats a half-byte mask as a full-byte mask (0? => ?? or ?F=> ??)
-            pattern[size] = 0xFF00; // Set the upper byte to 1 to indicate ignoring this byte
+    bool success = true;
+    if (pending_count > 0) {
+        ScanMultiPattern multi;
+        size_t regions_count = 0;
+        ProcessMap* regions = NULL;
+        if (!scan_compileMulti(pending, pending_count, &multi)) {
+            log_error("Failed to compile signatures");
+            success = false;
+        } else if (!(regions = maps_filter(filter, &regions_count))) {
+            log_error("Failed to get memory regions");
+            scan_freeMulti(&multi);
+            success = false;
         } else {
-            pattern[size] = strtol(token, NULL, 16);
+            uintptr_t* pending_matches = arena_alloc(pending_count * sizeof(uintptr_t));
+            bool* pending_found = arena_alloc(pending_count * sizeof(bool));
+            if (pending_matches && pending_found) {
+                scan_findParallel(process.pid, regions, regions_count, &multi, pending_matches, pending_found);
+                for (size_t j = 0; j < pending_count; j++) {
+                    size_t i = pending_index[j];
+                    found[i] = pending_found[j];
+                    matches[i] = pending_matches[j];
+                    if (found[i] && keys[i]) {
+                        scan_cacheStore(keys[i], matches[i]);
+                    }
+                }
+                scan_cacheSave();
+            } else {
+                log_error("Out of memory");
+                success = false;
+            }
+            scan_freeMulti(&multi);
         }
-        size++;
-        token = strtok(NULL, " ");
     }
 
-    free(signature_copy);
-    *pattern_size = size;
-    return pattern;
-}
-
-bool validate_process_memory(pid_t pid, uintptr_t address, void* buffer, size_t size)
-{
-    struct iovec local_iov = { buffer, size };
-    struct iovec remote_iov = { (void*)address, size };
-    ssize_t nread = process_vm_readv(pid, &local_iov, 1, &remote_iov, 1, 0);
-
-    return nread == (ssize_t)size;
+    return success;
 }
 
 /**
@@ -181,19 +182,27 @@ bool validate_process_memory(pid_t pid, uintptr_t address, void* buffer, size_t
  */
 int perform_sig_scan(lua_State* L)
 {
-    if (lua_gettop(L) != 2) {
-        log_error("Invalid number of arguments: expected 2 (signature, offset)");
+    if (lua_gettop(L) != 2 && lua_gettop(L) != 3) {
+        log_error("Invalid number of arguments: expected 2 or 3 (signature, offset, [options])");
+        lua_pushnil(L);
+        return 1;
+    }
+
+    if (!lua_isstring(L, 1) || !lua_isnumber(L, 2) || !(lua_isnoneornil(L, 3) || lua_istable(L, 3))) {
+        log_error("Invalid argument types: expected (string, number, [table])");
         lua_pushnil(L);
         return 1;
     }
 
-    if (!lua_isstring(L, 1) || !lua_isnumber(L, 2)) {
-        log_error("Invalid argument types: expected (string, number)");
+    MapsFilter filter = {
+        .min_address = 0,
+        .max_address = UINTPTR_MAX,
+    };
+    if (lua_istable(L, 3) && !read_scan_options(L, 3, &filter)) {
         lua_pushnil(L);
         return 1;
     }
 
-    pid_t p_pid = process.pid;
     const char* signature = lua_tostring(L, 1);
     intptr_t offset = lua_tointeger(L, 2);
 
@@ -204,68 +213,135 @@ int perform_sig_scan(lua_State* L)
         return 1;
     }
 
-    size_t pattern_length;
-    uint16_t* pattern = convert_signature(signature, &pattern_length);
-    if (!pattern) {
+    ArenaMark mark = arena_mark();
+    ScanPattern pattern;
+    if (!scan_compilePattern(signature, &pattern)) {
         log_error("Failed to convert signature");
+        arena_release(mark);
         lua_pushnil(L);
         return 1;
     }
+    char* key = scan_cacheKey(signature, &filter);
+    uintptr_t match;
+    bool found = false;
+    find_signatures(&pattern, &key, 1, &filter, &match, &found);
+    arena_release(mark);
+
+    if (found) {
+        // The resulting address is the start of the match
+        // plus the user-set offset, minus the process's base_address
+        // or a subsequent memory read will read the wrong address or
+        // go out of memory (due to commit 2b4417f offsetting memory reads)
+        // So this result might be negative if the main module happens to be after
+        // the found signature. This should be corrected by readAddress.
+        intptr_t result = (match + offset) - process.base_address;
+        lua_pushnumber(L, result);
+        return 1;
+    }
 
-    int regions_count = 0;
-    ProcessMap* regions = get_memory_regions(p_pid, &regions_count);
-    if (!regions) {
-        free(pattern);
-        log_error("Failed to get memory regions");
+    // No match found
+    log_error("No match found for the given signature");
+    lua_pushnil(L);
+    return 1;
+}
+
+/**
+ * Performs the Lua Auto Splitter sig_scan_many function, scanning the memory
+ * once for a whole table of signatures.
+ *
+ * Each entry of the table is either a signature string or a `{signature, offset}`
+ * table. The result table uses the same keys, with the same addresses sig_scan
+ * would return; entries that were not found are left out.
+ *
+ * @param L The lua state.
+ *
+ * @return Always 1 (either the results table or nil is pushed on the stack)
+ */
+int perform_sig_scan_many(lua_State* L)
+{
+    if (!lua_istable(L, 1) || !(lua_isnoneornil(L, 2) || lua_istable(L, 2))) {
+        log_error("Invalid argument types: expected (table, [table])");
         lua_pushnil(L);
         return 1;
     }
 
-    for (int i = 0; i < regions_count; i++) {
-        ProcessMap region = regions[i];
-        ssize_t region_size = region.end - region.start;
-        uint8_t* buffer = malloc(region_size);
-        if (!buffer) {
-            free(pattern);
-            free(regions);
-            log_error("Failed to allocate memory for region buffer");
-            lua_pushnil(L);
-            return 1;
-        }
-
-        if (!validate_process_memory(p_pid, region.start, buffer, region_size)) {
-            free(buffer);
-            continue; // Continue to next region
-        }
+    MapsFilter filter = {
+        .min_address = 0,
+        .max_address = UINTPTR_MAX,
+    };
+    if (lua_istable(L, 2) && !read_scan_options(L, 2, &filter)) {
+        lua_pushnil(L);
+        return 1;
+    }
 
-        for (size_t j = 0; j <= region_size - pattern_length; ++j) {
-            if (match_pattern(buffer + j, pattern, pattern_length)) {
-                // The resulting address is the start of the region
-                // plus the index of the first byte that matches
-                // plus the user-set offset, minus the process's base_address
-                // or a subsequent memory read will read the wrong address or
-                // go out of memory (due to commit 2b4417f offsetting memory reads)
-                // So this result might be negative if the main module happens to be after
-                // the found signature. This should be corrected by readAddress.
-                intptr_t result = (region.start + j + offset) - process.base_address;
+    size_t count = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0) {
+        count++;
+        lua_pop(L, 1);
+    }
 
-                free(buffer);
-                free(pattern);
-                free(regions);
+    ArenaMark mark = arena_mark();
+    ScanPattern* patterns = arena_calloc(count, sizeof(ScanPattern));
+    intptr_t* offsets = arena_calloc(count, sizeof(intptr_t));
+    uintptr_t* matches = arena_calloc(count, sizeof(uintptr_t));
+    bool* found = arena_calloc(count, sizeof(bool));
+    char** keys = arena_calloc(count, sizeof(char*));
+    if (!patterns || !offsets || !matches || !found || !keys) {
+        arena_release(mark);
+        log_error("Out of memory");
+        lua_pushnil(L);
+        return 1;
+    }
 
-                lua_pushnumber(L, result);
-                return 1;
+    // Keys are kept in an array at index 3, in the same order as the patterns
+    lua_settop(L, 2);
+    lua_newtable(L);
+    size_t compiled = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0) {
+        const char* signature = NULL;
+        intptr_t offset = 0;
+        if (lua_type(L, -1) == LUA_TSTRING) {
+            signature = lua_tostring(L, -1);
+        } else if (lua_istable(L, -1)) {
+            lua_rawgeti(L, -1, 1);
+            lua_rawgeti(L, -2, 2);
+            if (lua_type(L, -2) == LUA_TSTRING) {
+                signature = lua_tostring(L, -2);
+                offset = lua_tointeger(L, -1);
             }
+            // The signature stays referenced by the entry table
+            lua_pop(L, 2);
         }
 
-        free(buffer);
+        if (!signature || !scan_compilePattern(signature, &patterns[compiled])) {
+            lua_pushvalue(L, -2);
+            log_error("Invalid signature for key %s", lua_isstring(L, -1) ? lua_tostring(L, -1) : luaL_typename(L, -1));
+            lua_pop(L, 1);
+        } else {
+            offsets[compiled] = offset;
+            keys[compiled] = scan_cacheKey(signature, &filter);
+            lua_pushvalue(L, -2);
+            lua_rawseti(L, 3, compiled + 1);
+            compiled++;
+        }
+        lua_pop(L, 1);
     }
 
-    free(pattern);
-    free(regions);
+    find_signatures(patterns, keys, compiled, &filter, matches, found);
 
-    // No match found
-    log_error("No match found for the given signature");
-    lua_pushnil(L);
+    lua_newtable(L);
+    for (size_t i = 0; i < compiled; i++) {
+        if (found[i]) {
+            // Same base-relative result as sig_scan, see perform_sig_scan
+            intptr_t result = (matches[i] + offsets[i]) - process.base_address;
+            lua_rawgeti(L, 3, i + 1);
+            lua_pushnumber(L, result);
+            lua_settable(L, -3);
+        }
+    }
+
+    arena_release(mark);
     return 1;
 }
@@ -3,3 +3,4 @@
 #include <lua.h>
 
 int perform_sig_scan(lua_State* L);
+int perform_sig_scan_many(lua_State* L);
@@ -0,0 +1,90 @@
+#include "watch.h"
+
+#include "../memory/arena.h"
+#include "../memory/int64.h"
+#include "../utils.h"
+#include "../watch/watch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The Lua "watch" Auto Splitter function.
+ *
+ * Takes a name followed by the same arguments as readAddress, and registers a
+ * value read on every tick before the auto splitter functions run. The value
+ * is then available as `watchers.current[name]`, with the value of the
+ * previous tick as `watchers.old[name]` and whether it changed as
+ * `watchers.changed[name]`.
+ *
+ * @param L The Lua state.
+ *
+ * @return Always 1 (true, or nil on invalid arguments).
+ */
+int watch(lua_State* L)
+{
+    int top = lua_gettop(L);
+    if (top < 3 || lua_type(L, 1) != LUA_TSTRING || !lua_isstring(L, 2) || lua_isnil(L, 3)) {
+        printf("[watch] At least three arguments are required: name, type and address. Check your auto splitter code.\n");
+        lua_pushnil(L);
+        return 1;
+    }
+
+    ReadType type;
+    if (!readplan_parseType(lua_tostring(L, 2), &type)) {
+        printf("[watch] Invalid value type: %s\n", lua_tostring(L, 2));
+        lua_pushnil(L);
+        return 1;
+    }
+
+    const char* module = NULL;
+    int first_offset = 4;
+    if (lua_type(L, 3) == LUA_TSTRING && !lua_isnumber(L, 3)) {
+        if (top < 4) {
+            printf("[watch] The offset from the base address of module %s is required. Check your auto splitter code.\n", lua_tostring(L, 3));
+            lua_pushnil(L);
+            return 1;
+        }
+        module = lua_tostring(L, 3);
+        if (strcmp(module, process.name) == 0) {
+            module = NULL;
+        }
+        first_offset = 5;
+    }
+
+    int invalid = int64_findInvalid(L, first_offset - 1, top);
+    if (invalid) {
+        printf("[watch] Argument %d is not a valid address or offset: %s\n", invalid, value_to_c_string(L, invalid));
+        lua_pushnil(L);
+        return 1;
+    }
+
+    uint64_t offset;
+    int64_get(L, first_offset - 1, &offset);
+    int64_t base_offset = offset;
+
+    int offsets_count = top >= first_offset ? top - first_offset + 1 : 0;
+    ArenaMark mark = arena_mark();
+    int64_t* offsets = arena_alloc(offsets_count * sizeof(int64_t) + 1);
+    if (!offsets) {
+        printf("[watch] Memory allocation failed.\n");
+        arena_release(mark);
+        lua_pushnil(L);
+        return 1;
+    }
+    for (int i = 0; i < offsets_count; i++) {
+        int64_get(L, first_offset + i, &offset);
+        offsets[i] = offset;
+    }
+
+    bool added = watch_add(L, lua_tostring(L, 1), type, module, base_offset, offsets, offsets_count);
+    arena_release(mark);
+    if (!added) {
+        printf("[watch] Memory allocation failed.\n");
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <lua.h>
+
+int watch(lua_State* L);
@@ -0,0 +1,308 @@
+/** \file heap.c
+ *
+ * Allocator and garbage collector pacing of the auto splitter Lua State.
+ *
+ * Lua allocates lots of small objects (strings, tables, closures), so the
+ * allocations of up to HEAP_CLASSES * HEAP_CLASS_SIZE bytes are served from
+ * free lists of fixed size classes, carved from slabs that are only returned
+ * to the system when the Lua State is closed. Larger allocations go through
+ * malloc.
+ *
+ * The allocator also enforces the memory limit of the auto splitter: when an
+ * allocation would exceed it, it fails and Lua raises a "not enough memory"
+ * error in the function that allocated, instead of the script eating all the
+ * memory of the system. The limit is only enforced while the script runs in a
+ * protected call, since an allocation failing in the C code driving it would
+ * abort LibreSplit.
+ *
+ * Scripts may also stop the automatic garbage collector, so it never pauses a
+ * tick, and let heap_endTick run it in steps while waiting for the next tick.
+ *
+ * Only the LASR thread may use the heap.
+ */
+#include "heap.h"
+
+#include <lauxlib.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The largest pooled allocation, in bytes.
+ */
+#define HEAP_SMALL_MAX (HEAP_CLASSES * HEAP_CLASS_SIZE)
+
+/**
+ * A chunk of memory pooled allocations are carved from.
+ */
+typedef struct HeapSlab {
+    struct HeapSlab* next; /*!< The slab allocated before this one */
+    alignas(max_align_t) uint8_t data[]; /*!< The memory handed out */
+} HeapSlab;
+
+/**
+ * A pooled allocation that was freed, waiting to be reused.
+ */
+typedef struct HeapFreeBlock {
+    struct HeapFreeBlock* next; /*!< The next free block of the same class */
+} HeapFreeBlock;
+
+HeapStats heap_stats = { .limit = HEAP_DEFAULT_LIMIT };
+
+static HeapSlab* slabs = NULL;
+static HeapFreeBlock* free_blocks[HEAP_CLASSES];
+static uint8_t* slab_next = NULL; /*!< The memory of the current slab not handed out yet */
+static size_t slab_left = 0; /*!< The bytes left at `slab_next` */
+static uint64_t tick_start_allocated = 0; /*!< `heap_stats.allocated` when the tick started */
+static size_t collected_size = 0; /*!< The size of the heap after the last full collection */
+static bool enforcing = false; /*!< True while the script runs, see heap_enforceLimit */
+
+/**
+ * Gets the size class of a pooled allocation.
+ *
+ * @param size The size of the allocation, between 1 and HEAP_SMALL_MAX.
+ *
+ * @return The index of its class.
+ */
+static size_t size_class(size_t size)
+{
+    return (size - 1) / HEAP_CLASS_SIZE;
+}
+
+/**
+ * Allocates memory from the pool or, for large sizes, from malloc.
+ *
+ * @param size The size of the allocation.
+ *
+ * @return The memory, or NULL if the allocation failed.
+ */
+static void* acquire(size_t size)
+{
+    if (size > HEAP_SMALL_MAX) {
+        return malloc(size);
+    }
+
+    size_t class = size_class(size);
+    HeapFreeBlock* block = free_blocks[class];
+    if (block) {
+        free_blocks[class] = block->next;
+        return block;
+    }
+
+    size_t class_size = (class + 1) * HEAP_CLASS_SIZE;
+    if (slab_left < class_size) {
+        HeapSlab* slab = malloc(sizeof(HeapSlab) + HEAP_SLAB_SIZE);
+        if (!slab) {
+            return NULL;
+        }
+        slab->next = slabs;
+        slabs = slab;
+        slab_next = slab->data;
+        slab_left = HEAP_SLAB_SIZE;
+        heap_stats.pooled += HEAP_SLAB_SIZE;
+    }
+    void* memory = slab_next;
+    slab_next += class_size;
+    slab_left -= class_size;
+    return memory;
+}
+
+/**
+ * Frees memory allocated by acquire.
+ *
+ * @param memory The memory.
+ * @param size The size it was allocated with.
+ */
+static void release(void* memory, size_t size)
+{
+    if (size > HEAP_SMALL_MAX) {
+        free(memory);
+        return;
+    }
+    size_t class = size_class(size);
+    HeapFreeBlock* block = memory;
+    block->next = free_blocks[class];
+    free_blocks[class] = block;
+}
+
+/**
+ * The allocation function of the Lua State, see `lua_Alloc`.
+ *
+ * Lua always passes the size a block was allocated with when reallocating or
+ * freeing it, so the pool doesn't need to store it.
+ */
+static void* heap_allocate(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    (void)ud;
+    if (!ptr) {
+        osize = 0;
+    }
+    if (nsize == 0) {
+        if (ptr) {
+            release(ptr, osize);
+            heap_stats.in_use -= osize;
+        }
+        return NULL;
+    }
+    if (nsize > osize && enforcing && heap_stats.limit && heap_stats.in_use - osize + nsize > heap_stats.limit) {
+        heap_stats.refused++;
+        return NULL;
+    }
+
+    void* block;
+    if (!ptr) {
+        block = acquire(nsize);
+    } else if (osize <= HEAP_SMALL_MAX && nsize <= HEAP_SMALL_MAX && size_class(osize) == size_class(nsize)) {
+        block = ptr;
+    } else if (osize > HEAP_SMALL_MAX && nsize > HEAP_SMALL_MAX) {
+        block = realloc(ptr, nsize);
+    } else {
+        block = acquire(nsize);
+        if (block) {
+            memcpy(block, ptr, osize < nsize ? osize : nsize);
+            release(ptr, osize);
+        }
+    }
+    if (!block) {
+        return NULL;
+    }
+
+    heap_stats.in_use = heap_stats.in_use - osize + nsize;
+    if (nsize > osize) {
+        heap_stats.allocated += nsize - osize;
+    }
+    if (heap_stats.in_use > heap_stats.peak) {
+        heap_stats.peak = heap_stats.in_use;
+    }
+    return block;
+}
+
+/**
+ * Reports errors raised outside of a protected call, like luaL_newstate does.
+ */
+static int heap_panic(lua_State* L)
+{
+    fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+    return 0;
+}
+
+/**
+ * Creates the Lua State of an auto splitter, allocating from the heap.
+ *
+ * Builds of LuaJIT without 64-bit GC references don't support custom
+ * allocators, the Lua State then uses the default one, without a memory limit.
+ *
+ * @return The Lua State, or NULL if it couldn't be created.
+ */
+lua_State* heap_newState(void)
+{
+    lua_State* L = lua_newstate(heap_allocate, NULL);
+    heap_stats.active = L != NULL;
+    if (!L) {
+        heap_free();
+        printf("[heap] This LuaJIT doesn't support custom allocators, memoryLimit is ignored\n");
+        return luaL_newstate();
+    }
+    lua_atpanic(L, heap_panic);
+    return L;
+}
+
+/**
+ * Changes the memory limit of the Lua State.
+ *
+ * The limit is raised to leave HEAP_LIMIT_HEADROOM bytes above the memory
+ * already in use, so a too low limit doesn't make every allocation fail.
+ *
+ * @param limit The most bytes the Lua State may use, 0 for no limit.
+ *
+ * @return The limit applied.
+ */
+size_t heap_setLimit(size_t limit)
+{
+    size_t least = heap_stats.in_use + HEAP_LIMIT_HEADROOM;
+    if (limit && limit < least) {
+        limit = least;
+    }
+    heap_stats.limit = limit;
+    return limit;
+}
+
+/**
+ * Starts or stops enforcing the memory limit.
+ *
+ * Must only be enabled around the protected calls running the script, an
+ * allocation error outside of them makes LuaJIT abort.
+ *
+ * @param enforce True to enforce the limit.
+ */
+void heap_enforceLimit(bool enforce)
+{
+    enforcing = enforce;
+}
+
+/**
+ * Gets the current monotonic time, in nanoseconds.
+ */
+static long long now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Records the allocations of the tick that ended and, if the automatic garbage
+ * collector is stopped, runs it until the cycle is done or the time is up.
+ *
+ * At least one step is run, so the collector keeps up even when the ticks
+ * leave no time. Past three quarters of the memory limit, a full collection
+ * is run instead, so the steps never let the limit be reached.
+ *
+ * @param L The Lua State.
+ * @param collect True if the automatic garbage collector is stopped.
+ * @param budget_ns How long the collector may run.
+ */
+void heap_endTick(lua_State* L, bool collect, long long budget_ns)
+{
+    heap_stats.tick_allocated = heap_stats.allocated - tick_start_allocated;
+    tick_start_allocated = heap_stats.allocated;
+    if (!collect) {
+        return;
+    }
+
+    size_t size = (size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024;
+    size_t limit = heap_stats.active ? heap_stats.limit : 0;
+    if (limit && size > limit / 4 * 3 && size > collected_size + (limit - collected_size) / 2) {
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        collected_size = (size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024;
+    } else {
+        long long deadline = now_ns() + budget_ns;
+        while (!lua_gc(L, LUA_GCSTEP, HEAP_GC_STEP_KB) && now_ns() < deadline) {
+        }
+    }
+    // Stepping restarts the automatic collector
+    lua_gc(L, LUA_GCSTOP, 0);
+}
+
+/**
+ * Frees the slabs, once the Lua State is closed.
+ *
+ * The next Lua State starts with the default memory limit.
+ */
+void heap_free(void)
+{
+    while (slabs) {
+        HeapSlab* slab = slabs;
+        slabs = slab->next;
+        free(slab);
+    }
+    memset(free_blocks, 0, sizeof(free_blocks));
+    slab_next = NULL;
+    slab_left = 0;
+    tick_start_allocated = 0;
+    collected_size = 0;
+    enforcing = false;
+    heap_stats = (HeapStats) { .limit = HEAP_DEFAULT_LIMIT };
+}
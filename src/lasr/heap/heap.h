@@ -0,0 +1,59 @@
+#pragma once
+
+#include <lua.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The granularity of the pooled allocations, in bytes.
+ */
+#define HEAP_CLASS_SIZE 16
+
+/**
+ * The number of pooled size classes, larger allocations go through malloc.
+ */
+#define HEAP_CLASSES 16
+
+/**
+ * The size of a slab the pooled allocations are carved from, in bytes.
+ */
+#define HEAP_SLAB_SIZE (64 * 1024)
+
+/**
+ * The memory limit of an auto splitter, unless its startup() sets `memoryLimit`.
+ */
+#define HEAP_DEFAULT_LIMIT ((size_t)256 * 1024 * 1024)
+
+/**
+ * The least memory an auto splitter may allocate past what it already uses
+ * when its memory limit is set, in bytes.
+ */
+#define HEAP_LIMIT_HEADROOM ((size_t)4 * 1024 * 1024)
+
+/**
+ * The work done by a single step of the garbage collector between two ticks, in KB.
+ */
+#define HEAP_GC_STEP_KB 16
+
+/**
+ * How much memory the Lua State of the auto splitter uses.
+ */
+typedef struct HeapStats {
+    size_t limit; /*!< The most bytes the Lua State may use, 0 for no limit */
+    size_t in_use; /*!< The bytes the Lua State uses */
+    size_t peak; /*!< The most bytes the Lua State ever used */
+    size_t pooled; /*!< The bytes held by the slabs */
+    uint64_t allocated; /*!< The bytes allocated since the Lua State was created */
+    uint64_t tick_allocated; /*!< The bytes allocated during the last tick */
+    uint64_t refused; /*!< The allocations refused because of the limit */
+    bool active; /*!< False if the Lua State uses the default allocator */
+} HeapStats;
+
+extern HeapStats heap_stats;
+
+lua_State* heap_newState(void);
+size_t heap_setLimit(size_t limit);
+void heap_enforceLimit(bool enforce);
+void heap_endTick(lua_State* L, bool collect, long long budget_ns);
+void heap_free(void);
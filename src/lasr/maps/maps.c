@@ -1,5 +1,6 @@
 #include "maps.h"
 
+#include "src/lasr/memory/arena.h"
 #include "src/lasr/utils.h"
 
 #include <fcntl.h>
@@ -9,99 +10,476 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 
 #define STR_HELPER(x) #x
 #define STR(x) STR_HELPER(x)
 
-ProcessMap* maps_cache = NULL; // Array of cached maps
+ProcessMap* maps_cache = NULL; // Array of cached maps, sorted by address
 size_t maps_cache_size = 0; // Number of cached maps
+static size_t maps_cache_capacity = 0;
 
-// Use blocks to build the maps cache incrementally
-// This allows the cache to be built without knowing the total size in advance
-// Also makes it easier to manage memory so we dont overshoot in alloc size and grows predictably
-static MapsBlock* head = NULL; // Head of blocks
-static MapsBlock* current = NULL; // Current block being filled
+// Maps collected by a refresh, diffed against maps_cache before being swapped with it
+// Both arrays are kept around, so refreshes don't allocate once they are big enough
+static ProcessMap* maps_next = NULL;
+static size_t maps_next_size = 0;
+static size_t maps_next_capacity = 0;
+
+static bool maps_stale = true; // The cache has to be refreshed before its next use
+static unsigned int maps_generation = 0; // Bumped every time the layout changes
+
+/**
+ * A module (a file mapped in the process), at the lowest address it is mapped at.
+ */
+typedef struct MapsModule {
+    const char* name; // Points into the maps array the module list was built from
+    const char* basename; // The file name part of `name`
+    uintptr_t start;
+    size_t map; // Index of the lowest map of the module in the maps array
+} MapsModule;
+
+// Modules of maps_cache sorted by name
+static MapsModule* maps_modules = NULL;
+static size_t maps_modules_size = 0;
+
+// Open addressing hash of the module basenames, holding indexes in maps_modules plus one (0 for empty slots)
+static size_t* maps_module_hash = NULL;
+static size_t maps_module_hash_mask = 0;
+
+/**
+ * A subscriber to module events.
+ */
+typedef struct MapsSubscriber {
+    MapsEventCallback callback;
+    void* userdata;
+} MapsSubscriber;
+
+static MapsSubscriber maps_subscribers[MAPS_MAX_SUBSCRIBERS];
+
+/**
+ * A module name that wasn't found, and when to look for it again.
+ */
+typedef struct MapsMiss {
+    char* name;
+    long long retry_at; // Monotonic time in ms
+    unsigned int backoff; // Current backoff in ms
+} MapsMiss;
+
+static MapsMiss maps_misses[MAPS_MAX_MISSES];
 
 /**
- * Append a ProcessMap entry to the internal block list.
+ * Append a ProcessMap entry to the maps being collected.
  * @param e The ProcessMap entry to append.
  */
 static void append_entry(ProcessMap e)
 {
-    if (!current || current->used == MAPS_CACHE_BLOCK_SIZE) {
-        MapsBlock* new_block = malloc(sizeof(MapsBlock));
-        if (!new_block) {
-            perror("Failed to allocate memory for maps block");
+    if (maps_next_size == maps_next_capacity) {
+        size_t capacity = maps_next_capacity ? maps_next_capacity * 2 : MAPS_CACHE_INITIAL_CAPACITY;
+        ProcessMap* grown = realloc(maps_next, capacity * sizeof(ProcessMap));
+        if (!grown) {
+            perror("Failed to allocate memory for maps cache");
             exit(EXIT_FAILURE);
         }
+        maps_next = grown;
+        maps_next_capacity = capacity;
+    }
 
-        new_block->used = 0;
-        new_block->next = NULL;
+    maps_next[maps_next_size++] = e;
+}
 
-        if (!head)
-            head = new_block;
-        else
-            current->next = new_block;
+/**
+ * Compare two modules by name, for qsort and bsearch.
+ */
+static int maps_compareModules(const void* a, const void* b)
+{
+    return strcmp(((const MapsModule*)a)->name, ((const MapsModule*)b)->name);
+}
 
-        current = new_block;
+/**
+ * Build the list of modules of a maps array, sorted by name.
+ * @param maps The maps, sorted by address.
+ * @param count The number of maps.
+ * @param out_count Pointer to a size_t which receives the number of modules.
+ *
+ * Only maps backed by a file (with an absolute path as name) are modules.
+ *
+ * Returns: pointer to the malloc'd list, NULL on allocation failure.
+ */
+static MapsModule* maps_buildModules(const ProcessMap* maps, size_t count, size_t* out_count)
+{
+    *out_count = 0;
+    MapsModule* modules = malloc((count ? count : 1) * sizeof(MapsModule));
+    if (!modules)
+        return NULL;
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (maps[i].name[0] == '/') {
+            modules[total].name = maps[i].name;
+            modules[total].basename = strrchr(maps[i].name, '/') + 1;
+            modules[total].start = maps[i].start;
+            modules[total].map = i;
+            total++;
+        }
+    }
+    qsort(modules, total, sizeof(MapsModule), maps_compareModules);
+
+    // Keep the lowest start of every name
+    size_t unique = 0;
+    for (size_t i = 0; i < total; i++) {
+        if (unique > 0 && strcmp(modules[unique - 1].name, modules[i].name) == 0) {
+            if (modules[i].start < modules[unique - 1].start) {
+                modules[unique - 1].start = modules[i].start;
+                modules[unique - 1].map = modules[i].map;
+            }
+        } else {
+            modules[unique++] = modules[i];
+        }
     }
+    *out_count = unique;
+    return modules;
+}
 
-    current->entries[current->used++] = e;
+/**
+ * FNV-1a hash of a string.
+ */
+static size_t maps_hashString(const char* str)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *str; str++)
+        hash = (hash ^ (uint8_t)*str) * 1099511628211ULL;
+    return hash;
 }
+
 /**
- * Flatten the internal linked list of MapsBlock into a contiguous array.
- * @param out_count Pointer to a size_t which receives the number of entries.
+ * Rebuild the basename hash of `maps_modules`.
  *
- * Internal linked list of MapsBlock is left untouched, still being valid
+ * When several modules share a basename, the one at the lowest address
+ * wins, as it would with a substring search in address order.
+ */
+static void maps_buildModuleHash(void)
+{
+    free(maps_module_hash);
+    maps_module_hash = NULL;
+    maps_module_hash_mask = 0;
+
+    // Keep the load factor at or under one half
+    size_t slots = 16;
+    while (slots < maps_modules_size * 2)
+        slots *= 2;
+    maps_module_hash = calloc(slots, sizeof(size_t));
+    if (!maps_module_hash)
+        return;
+    maps_module_hash_mask = slots - 1;
+
+    for (size_t i = 0; i < maps_modules_size; i++) {
+        size_t slot = maps_hashString(maps_modules[i].basename) & maps_module_hash_mask;
+        for (;; slot = (slot + 1) & maps_module_hash_mask) {
+            size_t other = maps_module_hash[slot];
+            if (other == 0) {
+                maps_module_hash[slot] = i + 1;
+                break;
+            }
+            if (strcmp(maps_modules[other - 1].basename, maps_modules[i].basename) == 0) {
+                if (maps_modules[i].start < maps_modules[other - 1].start)
+                    maps_module_hash[slot] = i + 1;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Look up a module by its exact basename, like "UnityPlayer.dll".
  *
- * Returns: pointer to malloc'd array of ProcessMap entries.
+ * Returns: the module, NULL if no module has this basename.
  */
-static ProcessMap* maps_flatten(size_t* out_count)
+static const MapsModule* maps_findModuleByBasename(const char* basename)
 {
-    size_t total = 0;
-    for (MapsBlock* b = head; b; b = b->next)
-        total += b->used;
+    if (!maps_module_hash)
+        return NULL;
+    size_t slot = maps_hashString(basename) & maps_module_hash_mask;
+    for (; maps_module_hash[slot]; slot = (slot + 1) & maps_module_hash_mask) {
+        const MapsModule* module = &maps_modules[maps_module_hash[slot] - 1];
+        if (strcmp(module->basename, basename) == 0)
+            return module;
+    }
+    return NULL;
+}
 
-    ProcessMap* arr = malloc(total * sizeof(ProcessMap));
-    if (!arr)
-        abort();
+/**
+ * Look up a module by its full name.
+ *
+ * Returns: the module, NULL if there is no such module.
+ */
+static const MapsModule* maps_findModuleByName(const char* name)
+{
+    MapsModule key = { .name = name };
+    return bsearch(&key, maps_modules, maps_modules_size, sizeof(MapsModule), maps_compareModules);
+}
 
-    size_t idx = 0;
-    for (MapsBlock* b = head; b; b = b->next) {
-        memcpy(&arr[idx], b->entries, b->used * sizeof(ProcessMap));
-        idx += b->used;
+/**
+ * Find the map containing an address in the current cache, with a binary search.
+ *
+ * Returns: the index of the map, or `maps_cache_size` if no map contains the address.
+ */
+static size_t maps_findMapIndex(uintptr_t address)
+{
+    size_t low = 0, high = maps_cache_size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (maps_cache[middle].end <= address)
+            low = middle + 1;
+        else
+            high = middle;
     }
+    if (low < maps_cache_size && maps_cache[low].start <= address)
+        return low;
+    return maps_cache_size;
+}
 
-    *out_count = total;
-    return arr;
+/**
+ * Send an event to all the subscribers.
+ */
+static void maps_notify(MapsEvent event, const char* module, uintptr_t start)
+{
+    for (size_t i = 0; i < MAPS_MAX_SUBSCRIBERS; i++) {
+        if (maps_subscribers[i].callback)
+            maps_subscribers[i].callback(event, module, start, maps_subscribers[i].userdata);
+    }
 }
 
 /**
- * Free and clear the maps cache and internal block list.
+ * Check if two maps arrays describe the same layout.
  *
- * For use before rebuilding the cache from scratch
+ * Returns: true if both have the same maps, with the same names and permissions.
+ */
+static bool maps_sameLayout(const ProcessMap* a, size_t a_count, const ProcessMap* b, size_t b_count)
+{
+    if (a_count != b_count)
+        return false;
+    for (size_t i = 0; i < a_count; i++) {
+        if (a[i].start != b[i].start || a[i].end != b[i].end || strcmp(a[i].perms, b[i].perms) != 0 || strcmp(a[i].name, b[i].name) != 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Start collecting a fresh set of maps with append_entry.
+ */
+static void maps_beginRefresh(void)
+{
+    maps_next_size = 0;
+}
+
+/**
+ * Diff the collected maps against the cache and make them the new cache.
  *
- * Frees all allocated MapsBlock structures used for incremental collection
- * and frees the flattened `maps_cache` array if present. Resets the
- * `head`, `current`, and `maps_cache_size` to their empty states.
+ * If the layout didn't change the cache is left as is. Otherwise the
+ * generation is bumped, the collected maps are swapped with the cache,
+ * and subscribers are told which modules were loaded, unloaded or moved.
  */
-void maps_clearCache(void)
+static void maps_commitRefresh(void)
 {
-    MapsBlock* b = head;
-    while (b) {
-        MapsBlock* next = b->next;
-        free(b);
-        b = next;
+    maps_stale = false;
+    if (maps_cache && maps_sameLayout(maps_cache, maps_cache_size, maps_next, maps_next_size))
+        return;
+    maps_generation++;
+
+    size_t modules_size;
+    MapsModule* modules = maps_buildModules(maps_next, maps_next_size, &modules_size);
+
+    // Swap the collected maps with the cache
+    ProcessMap* maps = maps_cache;
+    size_t capacity = maps_cache_capacity;
+    maps_cache = maps_next;
+    maps_cache_size = maps_next_size;
+    maps_cache_capacity = maps_next_capacity;
+    maps_next = maps;
+    maps_next_capacity = capacity;
+    maps_next_size = 0;
+
+    // Both lists are sorted by name, so they can be merged to find the differences
+    MapsModule* old_modules = maps_modules;
+    size_t old_size = maps_modules_size;
+    maps_modules = modules;
+    maps_modules_size = modules ? modules_size : 0;
+    maps_buildModuleHash();
+
+    // Old module names point into maps_next, which is only overwritten by the next refresh
+    size_t i = 0, j = 0;
+    while (i < old_size || j < maps_modules_size) {
+        int order = i == old_size ? 1 : j == maps_modules_size ? -1
+                                                             : strcmp(old_modules[i].name, maps_modules[j].name);
+        if (order < 0) {
+            maps_notify(MAPS_EVENT_UNLOADED, old_modules[i].name, old_modules[i].start);
+            i++;
+        } else if (order > 0) {
+            maps_notify(MAPS_EVENT_LOADED, maps_modules[j].name, maps_modules[j].start);
+            j++;
+        } else {
+            if (old_modules[i].start != maps_modules[j].start)
+                maps_notify(MAPS_EVENT_MOVED, maps_modules[j].name, maps_modules[j].start);
+            i++;
+            j++;
+        }
     }
-    head = NULL;
-    current = NULL;
+    free(old_modules);
+}
 
-    if (maps_cache) {
-        free(maps_cache);
-        maps_cache = NULL;
-        maps_cache_size = 0;
+/**
+ * Get the current maps layout generation.
+ *
+ * The generation changes whenever a refresh of the cache finds mappings
+ * that were added, removed or changed, allowing callers to keep resolved
+ * module addresses around until the layout changes.
+ *
+ * @return The current generation.
+ */
+unsigned int maps_getGeneration(void)
+{
+    return maps_generation;
+}
+
+/**
+ * Subscribe to module events.
+ * @param callback The function called for every module loaded, unloaded or moved.
+ * @param userdata Passed as is to the callback.
+ *
+ * Events are sent by the refresh that detects the change, once the cache
+ * holds the new layout.
+ *
+ * Returns: the subscription id, -1 if there are too many subscribers.
+ */
+int maps_subscribe(MapsEventCallback callback, void* userdata)
+{
+    for (int i = 0; i < MAPS_MAX_SUBSCRIBERS; i++) {
+        if (!maps_subscribers[i].callback) {
+            maps_subscribers[i].callback = callback;
+            maps_subscribers[i].userdata = userdata;
+            return i;
+        }
     }
+    return -1;
+}
+
+/**
+ * Cancel a subscription to module events.
+ * @param id The id returned by maps_subscribe.
+ */
+void maps_unsubscribe(int id)
+{
+    if (id >= 0 && id < MAPS_MAX_SUBSCRIBERS)
+        maps_subscribers[id].callback = NULL;
+}
+
+/**
+ * Get the monotonic time in milliseconds.
+ */
+static long long maps_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Find the negative cache entry of a name.
+ *
+ * Returns: the entry, NULL if the name isn't negative-cached.
+ */
+static MapsMiss* maps_findMiss(const char* name)
+{
+    for (size_t i = 0; i < MAPS_MAX_MISSES; i++) {
+        if (maps_misses[i].name && strcmp(maps_misses[i].name, name) == 0)
+            return &maps_misses[i];
+    }
+    return NULL;
+}
+
+/**
+ * Record that a name wasn't found, doubling its backoff if it was already missing.
+ * @param name The name that wasn't found.
+ */
+static void maps_recordMiss(const char* name)
+{
+    MapsMiss* miss = maps_findMiss(name);
+    if (!miss) {
+        // Take a free entry, or the one due the soonest
+        miss = &maps_misses[0];
+        for (size_t i = 0; i < MAPS_MAX_MISSES && miss->name; i++) {
+            if (!maps_misses[i].name || maps_misses[i].retry_at < miss->retry_at)
+                miss = &maps_misses[i];
+        }
+        free(miss->name);
+        miss->name = strdup(name);
+        miss->backoff = 0;
+        if (!miss->name)
+            return;
+    }
+    miss->backoff = miss->backoff ? miss->backoff * 2 : MAPS_MISS_BACKOFF_MIN;
+    if (miss->backoff > MAPS_MISS_BACKOFF_MAX)
+        miss->backoff = MAPS_MISS_BACKOFF_MAX;
+    miss->retry_at = maps_now() + miss->backoff;
+}
+
+/**
+ * Forget that a name was missing.
+ * @param name The name that was found.
+ */
+static void maps_forgetMiss(const char* name)
+{
+    MapsMiss* miss = maps_findMiss(name);
+    if (miss) {
+        free(miss->name);
+        miss->name = NULL;
+    }
+}
+
+/**
+ * Free and clear the maps cache.
+ *
+ * Frees both maps arrays, the module list and the negative cache, for when
+ * the cache won't be used anymore, like when the game process changes.
+ * Subscriptions are kept.
+ */
+void maps_clearCache(void)
+{
+    free(maps_cache);
+    maps_cache = NULL;
+    maps_cache_size = 0;
+    maps_cache_capacity = 0;
+
+    free(maps_next);
+    maps_next = NULL;
+    maps_next_size = 0;
+    maps_next_capacity = 0;
+
+    free(maps_modules);
+    maps_modules = NULL;
+    maps_modules_size = 0;
+    free(maps_module_hash);
+    maps_module_hash = NULL;
+    maps_module_hash_mask = 0;
+
+    for (size_t i = 0; i < MAPS_MAX_MISSES; i++) {
+        free(maps_misses[i].name);
+        maps_misses[i].name = NULL;
+    }
+    maps_stale = true;
+}
+
+/**
+ * Mark the maps cache as outdated.
+ *
+ * The cache is kept, and refreshed the next time it is needed. Refreshing
+ * only swaps arrays when the layout actually changed.
+ */
+void maps_invalidate(void)
+{
+    maps_stale = true;
 }
 
 #ifdef IOCTL_MAPS
@@ -135,7 +513,7 @@ static bool maps_ioctlSupported(void)
  * Populate the maps cache by querying the target process maps.
  *
  * uses `ioctl(PROCMAP_QUERY)` in a loop to collect all VMA information.
- * Entries are collected into internal blocks and then flattened into `maps_cache`.
+ * Entries are collected into a fresh array and then diffed against `maps_cache`.
  *
  * @return Number of maps collected
  */
@@ -150,7 +528,7 @@ static size_t maps_getAll_ioctl(void)
         q.size = sizeof(q);
         q.query_flags = PROCMAP_QUERY_COVERING_OR_NEXT_VMA;
         q.query_addr = 0;
-        maps_clearCache();
+        maps_beginRefresh();
         for (;;) {
             q.vma_name_addr = (uintptr_t)map_name;
             q.vma_name_size = sizeof(map_name);
@@ -162,6 +540,13 @@ static size_t maps_getAll_ioctl(void)
                 .start = q.vma_start,
                 .end = q.vma_end,
                 .size = q.vma_end - q.vma_start,
+                .perms = {
+                    q.vma_flags & PROCMAP_QUERY_VMA_READABLE ? 'r' : '-',
+                    q.vma_flags & PROCMAP_QUERY_VMA_WRITABLE ? 'w' : '-',
+                    q.vma_flags & PROCMAP_QUERY_VMA_EXECUTABLE ? 'x' : '-',
+                    q.vma_flags & PROCMAP_QUERY_VMA_SHARED ? 's' : 'p',
+                    '\0',
+                },
             };
             strncpy(map.name, q.vma_name_addr ? map_name : "", sizeof(map.name));
             map.name[sizeof(map.name) - 1] = '\0';
@@ -170,7 +555,7 @@ static size_t maps_getAll_ioctl(void)
             q.query_addr = q.vma_end;
         }
         close(f);
-        maps_cache = maps_flatten(&maps_cache_size);
+        maps_commitRefresh();
     }
     return maps_cache_size;
 }
@@ -189,15 +574,21 @@ static bool maps_parseMapsLine(const char* line, ProcessMap* map)
     uint64_t size;
     char mode[8];
     unsigned long offset;
-    unsigned int major_id, minor_id, node_id;
+    unsigned int major_id, minor_id;
+    unsigned long node_id;
+
+    // Anonymous maps have no name, so sscanf won't touch it
+    map->name[0] = '\0';
 
     // Thank you kernel source code
-    int sscanf_res = sscanf(line, "%lx-%lx %7s %lx %u:%u %u %" STR(PATH_MAX) "[^\n]", &map->start,
+    int sscanf_res = sscanf(line, "%lx-%lx %7s %lx %x:%x %lu %" STR(PATH_MAX) "[^\n]", &map->start,
         &map->end, mode, &offset, &major_id,
         &minor_id, &node_id, map->name);
-    if (!sscanf_res)
+    if (sscanf_res < 3)
         return false;
 
+    snprintf(map->perms, sizeof(map->perms), "%s", mode);
+
     // Calculate the map size
     size = map->end - map->start;
     map->size = size;
@@ -219,7 +610,7 @@ static size_t maps_getAll_legacy(void)
 
     if (f) {
         char current_line[PATH_MAX + 100];
-        maps_clearCache();
+        maps_beginRefresh();
         while (fgets(current_line, sizeof(current_line), f) != NULL) {
             ProcessMap map;
             if (maps_parseMapsLine(current_line, &map)) {
@@ -229,7 +620,7 @@ static size_t maps_getAll_legacy(void)
             }
         }
         fclose(f);
-        maps_cache = maps_flatten(&maps_cache_size);
+        maps_commitRefresh();
     }
     return maps_cache_size;
 }
@@ -261,7 +652,7 @@ static size_t maps_getAll_init(void)
 #endif
 
 /**
- * Get all process maps and populate the maps cache.
+ * Get all process maps and refresh the maps cache.
  *
  * @return Number of maps collected
  */
@@ -270,15 +661,55 @@ size_t maps_getAll(void)
     return (*maps_getAll_var)();
 }
 
+/**
+ * Refresh the maps cache only if it was invalidated since the last refresh.
+ *
+ * @return Number of cached maps
+ */
+size_t maps_update(void)
+{
+    if (maps_stale)
+        return maps_getAll();
+    return maps_cache_size;
+}
+
+/**
+ * Search the current `maps_cache` for a map by name.
+ *
+ * A name that is exactly the basename of a module is found through the module
+ * index, giving the lowest map of that module. Any other name falls back to a
+ * substring search over all the maps, in address order.
+ *
+ * Returns: true if a matching map was found.
+ */
+static bool maps_findMapByNameCached(const char* name, ProcessMap* out_map)
+{
+    const MapsModule* module = maps_findModuleByBasename(name);
+    if (module) {
+        *out_map = maps_cache[module->map];
+        return true;
+    }
+
+    for (size_t i = 0; i < maps_cache_size; i++) {
+        if (strstr(maps_cache[i].name, name) != NULL) {
+            *out_map = maps_cache[i];
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * Find a map by substring match on its name.
  * @param name Substring to search for (must not be NULL).
  * @param out_map Pointer to ProcessMap to receive result on success.
  *
- * Searches the current `maps_cache` for an entry whose name contains
- * the provided substring. If no entry is found, the cache is refreshed via
- * `maps_getAll()` and the search is retried. On success the matching
- * ProcessMap is copied into `out_map`
+ * Searches the `maps_cache`, refreshed first if it was invalidated. If no
+ * entry is found, the cache is refreshed via `maps_getAll()` and the search
+ * is retried. Names that still aren't found are negative-cached: they are
+ * reported missing without refreshing the cache until their backoff expires,
+ * and the backoff doubles every time they are still missing.
+ * On success the matching ProcessMap is copied into `out_map`
  *
  * Returns: true if a matching map was found, false otherwise.
  */
@@ -287,27 +718,162 @@ bool maps_findMapByName(const char* name, ProcessMap* out_map)
     if (!name)
         return false;
 
-    for (uint32_t i = 0; i < maps_cache_size; i++) {
-        const char* map_name = maps_cache[i].name;
-        if (strstr(map_name, name) != NULL) {
-            *out_map = maps_cache[i];
-            return true;
-        }
+    bool refreshed = maps_stale;
+    maps_update();
+    bool found = maps_findMapByNameCached(name, out_map);
+
+    if (!found) {
+        MapsMiss* miss = maps_findMiss(name);
+        if (miss && maps_now() < miss->retry_at)
+            return false;
+
+        // We didnt find it, get
+        if (!refreshed)
+            maps_getAll();
+        found = maps_findMapByNameCached(name, out_map);
+        if (!found)
+            maps_recordMiss(name);
+    }
+    if (found)
+        maps_forgetMiss(name);
+
+    if (!maps_cache_cycles) { // Cache is disabled, refresh on next use
+        maps_invalidate();
     }
+    return found;
+}
+
+/**
+ * Find the file-backed module containing an address in the current cache.
+ * @param address The address to look up.
+ * @param out_map Pointer to ProcessMap to receive the module.
+ *
+ * Returns: true if the address belongs to a map backed by a file.
+ */
+static bool maps_findModuleOfCached(uintptr_t address, ProcessMap* out_map)
+{
+    size_t index = maps_findMapIndex(address);
+    if (index == maps_cache_size || maps_cache[index].name[0] != '/')
+        return false;
+
+    const MapsModule* module = maps_findModuleByName(maps_cache[index].name);
+    if (!module)
+        return false;
+    *out_map = maps_cache[index];
+    out_map->start = module->start;
+    return true;
+}
+
+/**
+ * Find the file-backed module containing an address.
+ * @param address The address to look up.
+ * @param out_map Pointer to ProcessMap to receive the module: its name, and
+ * its start set to the lowest start among the maps of the same file.
+ *
+ * Searches the current `maps_cache` first, refreshing it via `maps_getAll()`
+ * if the address isn't found.
+ *
+ * Returns: true if the address belongs to a map backed by a file.
+ */
+bool maps_findModuleOf(uintptr_t address, ProcessMap* out_map)
+{
+    if (maps_findModuleOfCached(address, out_map))
+        return true;
 
-    // We didnt find it, get
     maps_getAll();
+    bool found = maps_findModuleOfCached(address, out_map);
+    if (!maps_cache_cycles) { // Cache is disabled, refresh on next use
+        maps_invalidate();
+    }
+    return found;
+}
 
-    for (uint32_t i = 0; i < maps_cache_size; i++) {
-        const char* map_name = maps_cache[i].name;
-        if (strstr(map_name, name) != NULL) {
-            *out_map = maps_cache[i];
-            if (!maps_cache_cycles) { // Cache is disabled, clear after use
-                maps_clearCache();
-            }
-            return true;
-        }
+/**
+ * Get the lowest start address of the maps backed by a file.
+ * @param path The exact name of the maps, as in /proc/pid/maps.
+ * @param out_base Pointer to receive the lowest start address.
+ *
+ * Refreshes the maps cache first if it was invalidated.
+ *
+ * Returns: true if the file is mapped in the process.
+ */
+bool maps_findModuleBase(const char* path, uintptr_t* out_base)
+{
+    maps_update();
+
+    const MapsModule* module = maps_findModuleByName(path);
+    if (module)
+        *out_base = module->start;
+
+    if (!maps_cache_cycles) { // Cache is disabled, refresh on next use
+        maps_invalidate();
     }
+    return module != NULL;
+}
 
-    return false;
+/**
+ * Check if the permissions of a map satisfy a permissions filter.
+ * @param perms The permissions of the map, like "r-xp".
+ * @param filter The filter: letters are required, '-' forbids the
+ * permission in that position and '?' (or a shorter filter) accepts anything.
+ *
+ * Returns: true if the map satisfies the filter.
+ */
+static bool maps_permsMatch(const char* perms, const char* filter)
+{
+    for (size_t i = 0; filter[i] && i < 4; i++) {
+        if (filter[i] == '?')
+            continue;
+        if (filter[i] == '-' ? perms[i] != '-' : perms[i] != filter[i])
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Get the maps matching a filter, refreshing the maps cache first.
+ * @param filter The filter to apply.
+ * @param out_count Pointer to a size_t which receives the number of maps returned.
+ *
+ * Maps that aren't readable are always left out. Maps that cross the
+ * filter address range are clipped to it.
+ *
+ * Returns: pointer to an array of ProcessMap entries sorted by address,
+ * allocated from the LASR arena, NULL on allocation failure.
+ */
+ProcessMap* maps_filter(const MapsFilter* filter, size_t* out_count)
+{
+    maps_getAll();
+
+    ProcessMap* regions = arena_alloc((maps_cache_size ? maps_cache_size : 1) * sizeof(ProcessMap));
+    if (!regions)
+        return NULL;
+
+    size_t count = 0;
+    for (size_t i = 0; i < maps_cache_size; i++) {
+        ProcessMap map = maps_cache[i];
+        if (map.perms[0] != 'r')
+            continue;
+        if (filter->perms && !maps_permsMatch(map.perms, filter->perms))
+            continue;
+        if (filter->module && strstr(map.name, filter->module) == NULL)
+            continue;
+        if (map.start < filter->min_address)
+            map.start = filter->min_address;
+        if (map.end > filter->max_address)
+            map.end = filter->max_address;
+        if (map.start >= map.end)
+            continue;
+        map.size = map.end - map.start;
+        if (filter->max_size && map.size > filter->max_size)
+            continue;
+        regions[count++] = map;
+    }
+
+    if (!maps_cache_cycles) { // Cache is disabled, refresh on next use
+        maps_invalidate();
+    }
+
+    *out_count = count;
+    return regions;
 }
@@ -3,16 +3,62 @@
 #include "src/lasr/utils.h"
 #include <stdbool.h>
 
-#define MAPS_CACHE_BLOCK_SIZE 256
+#define MAPS_CACHE_INITIAL_CAPACITY 256
 
-typedef struct MapsBlock {
-    struct MapsBlock* next;
-    size_t used;
-    ProcessMap entries[MAPS_CACHE_BLOCK_SIZE];
-} MapsBlock;
+#define MAPS_MAX_SUBSCRIBERS 16
+
+/**
+ * Number of module names that can be negative-cached at once.
+ */
+#define MAPS_MAX_MISSES 32
+
+/**
+ * Backoff in milliseconds before looking again for a missing module, doubled
+ * on every miss up to the maximum.
+ */
+#define MAPS_MISS_BACKOFF_MIN 50
+#define MAPS_MISS_BACKOFF_MAX 2000
+
+/**
+ * Changes to the modules mapped in the process.
+ */
+typedef enum MapsEvent {
+    MAPS_EVENT_LOADED, /*!< A module was mapped */
+    MAPS_EVENT_UNLOADED, /*!< A module isn't mapped anymore */
+    MAPS_EVENT_MOVED, /*!< The lowest address of a module changed */
+} MapsEvent;
+
+/**
+ * Called for every module event.
+ *
+ * @param event What happened to the module.
+ * @param module The path of the module.
+ * @param start The lowest address of the module, its old one if it was unloaded.
+ * @param userdata The pointer given to maps_subscribe.
+ */
+typedef void (*MapsEventCallback)(MapsEvent event, const char* module, uintptr_t start, void* userdata);
+
+/**
+ * Criteria to select a subset of the process maps.
+ */
+typedef struct MapsFilter {
+    const char* module; /*!< Substring of the map name, NULL for any map */
+    const char* perms; /*!< Permissions like "r-x", NULL for any permissions */
+    uintptr_t min_address; /*!< Lowest address to include */
+    uintptr_t max_address; /*!< Highest address to include (exclusive) */
+    uintptr_t max_size; /*!< Maps bigger than this are left out, 0 for no limit */
+} MapsFilter;
 
 extern int maps_cache_cycles;
 
 size_t maps_getAll(void);
+size_t maps_update(void);
+void maps_invalidate(void);
 void maps_clearCache(void);
 bool maps_findMapByName(const char* name, ProcessMap* out_map);
+unsigned int maps_getGeneration(void);
+ProcessMap* maps_filter(const MapsFilter* filter, size_t* out_count);
+bool maps_findModuleOf(uintptr_t address, ProcessMap* out_map);
+bool maps_findModuleBase(const char* path, uintptr_t* out_base);
+int maps_subscribe(MapsEventCallback callback, void* userdata);
+void maps_unsubscribe(int id);
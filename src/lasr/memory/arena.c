@@ -0,0 +1,222 @@
+/** \file arena.c
+ *
+ * Bump allocator for the temporary buffers of the LASR functions.
+ *
+ * The LASR functions allocate their temporaries from a single block that is
+ * reset at the end of every tick, instead of going through malloc and free
+ * on every call. When the block is full, more blocks are chained to it, and
+ * the next reset replaces them with one block big enough for the whole tick,
+ * so after a few ticks a script doesn't allocate memory anymore.
+ *
+ * The block doesn't keep the size of a single large tick forever: every
+ * ARENA_SHRINK_TICKS ticks it shrinks to the most the ticks since used, and
+ * it never grows past ARENA_MAX_BLOCK_SIZE, larger ticks chaining blocks that
+ * the reset frees.
+ *
+ * Functions can also free their temporaries early with arena_mark and
+ * arena_release, which keeps scripts calling them in a loop outside of the
+ * ticks from growing the arena.
+ *
+ * Only the LASR thread may use the arena.
+ */
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A chunk of memory allocations are carved from.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock* previous; /*!< The block that was full before this one */
+    size_t size; /*!< The size of `data` */
+    size_t used; /*!< The bytes of `data` already allocated */
+    size_t base; /*!< The bytes in use in the previous blocks */
+    alignas(max_align_t) uint8_t data[]; /*!< The memory handed out */
+} ArenaBlock;
+
+ArenaStats arena_stats;
+
+static ArenaBlock* current = NULL;
+static size_t wanted_size = ARENA_BLOCK_SIZE; /*!< The size of the block to use after the next reset */
+static size_t tick_peak = 0; /*!< The most bytes in use since the last reset */
+static size_t window_peak = 0; /*!< The most bytes in use since wanted_size last shrank */
+static unsigned window_ticks = 0; /*!< The ticks since wanted_size last shrank */
+
+/**
+ * Gets the size of the block to keep for a tick.
+ *
+ * @param in_use The most bytes the tick had in use.
+ *
+ * @return The size, between ARENA_BLOCK_SIZE and ARENA_MAX_BLOCK_SIZE.
+ */
+static size_t block_size_for(size_t in_use)
+{
+    if (in_use < ARENA_BLOCK_SIZE) {
+        return ARENA_BLOCK_SIZE;
+    }
+    return in_use < ARENA_MAX_BLOCK_SIZE ? in_use : ARENA_MAX_BLOCK_SIZE;
+}
+
+/**
+ * Adds a block to the arena.
+ *
+ * @param size The usable size of the block.
+ *
+ * @return False if the allocation failed.
+ */
+static bool push_block(size_t size)
+{
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) {
+        return false;
+    }
+    block->previous = current;
+    block->size = size;
+    block->used = 0;
+    block->base = current ? current->base + current->used : 0;
+    if (current) {
+        arena_stats.overflows++;
+    }
+    current = block;
+    arena_stats.capacity += size;
+    return true;
+}
+
+/**
+ * Frees the current block, the previous one becoming current.
+ */
+static void pop_block(void)
+{
+    ArenaBlock* block = current;
+    current = block->previous;
+    arena_stats.capacity -= block->size;
+    free(block);
+}
+
+/**
+ * Allocates memory until the next arena_reset or arena_release.
+ *
+ * @param size The number of bytes to allocate.
+ *
+ * @return The memory, aligned for any type, or NULL if the allocation failed.
+ */
+void* arena_alloc(size_t size)
+{
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+    if (!current || current->size - current->used < size) {
+        size_t block_size = current ? current->size * 2 : wanted_size;
+        if (!push_block(block_size > size ? block_size : size)) {
+            return NULL;
+        }
+    }
+
+    void* memory = current->data + current->used;
+    current->used += size;
+    size_t in_use = current->base + current->used;
+    if (in_use > tick_peak) {
+        tick_peak = in_use;
+    }
+    if (in_use > arena_stats.peak) {
+        arena_stats.peak = in_use;
+    }
+    return memory;
+}
+
+/**
+ * Allocates zeroed memory for an array until the next arena_reset or arena_release.
+ *
+ * @param count The number of elements.
+ * @param size The size of an element.
+ *
+ * @return The memory, or NULL if the allocation failed.
+ */
+void* arena_calloc(size_t count, size_t size)
+{
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void* memory = arena_alloc(count * size);
+    if (memory) {
+        memset(memory, 0, count * size);
+    }
+    return memory;
+}
+
+/**
+ * Gets the current position of the arena.
+ *
+ * @return The mark to pass to arena_release.
+ */
+ArenaMark arena_mark(void)
+{
+    return (ArenaMark) { .block = current, .used = current ? current->used : 0 };
+}
+
+/**
+ * Frees everything allocated since a mark was taken.
+ *
+ * @param mark The mark returned by arena_mark.
+ */
+void arena_release(ArenaMark mark)
+{
+    while (current && current != mark.block) {
+        pop_block();
+    }
+    if (current) {
+        current->used = mark.used;
+    }
+}
+
+/**
+ * Frees everything allocated from the arena, at the end of a tick.
+ *
+ * If the tick needed more than a block, the blocks are replaced by one block
+ * big enough for it, up to ARENA_MAX_BLOCK_SIZE. Every ARENA_SHRINK_TICKS
+ * ticks, the block is replaced by one just big enough for those ticks.
+ */
+void arena_reset(void)
+{
+    if (tick_peak > window_peak) {
+        window_peak = tick_peak;
+    }
+    if (++window_ticks >= ARENA_SHRINK_TICKS) {
+        wanted_size = block_size_for(window_peak);
+        window_peak = 0;
+        window_ticks = 0;
+    } else if (tick_peak > wanted_size) {
+        wanted_size = block_size_for(tick_peak);
+    }
+
+    if (current && (current->previous || current->size != wanted_size)) {
+        while (current) {
+            pop_block();
+        }
+    }
+    if (!current) {
+        // On failure, the next allocations try again
+        push_block(wanted_size);
+    } else {
+        current->used = 0;
+    }
+    arena_stats.tick_peak = tick_peak;
+    tick_peak = 0;
+}
+
+/**
+ * Frees all the memory of the arena.
+ *
+ * The next allocations start from a block of ARENA_BLOCK_SIZE again.
+ */
+void arena_free(void)
+{
+    while (current) {
+        pop_block();
+    }
+    wanted_size = ARENA_BLOCK_SIZE;
+    tick_peak = 0;
+    window_peak = 0;
+    window_ticks = 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The default size of an arena block, in bytes.
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/**
+ * The largest block the arena keeps between ticks, in bytes.
+ */
+#define ARENA_MAX_BLOCK_SIZE (1024 * 1024)
+
+/**
+ * The number of ticks after which the block shrinks back to what they used.
+ */
+#define ARENA_SHRINK_TICKS 256
+
+/**
+ * A position in the arena, to free everything allocated after it.
+ */
+typedef struct ArenaMark {
+    void* block; /*!< The block that was current */
+    size_t used; /*!< The bytes used in that block */
+} ArenaMark;
+
+/**
+ * How much memory the arena uses.
+ */
+typedef struct ArenaStats {
+    size_t capacity; /*!< The bytes currently allocated for the arena */
+    size_t tick_peak; /*!< The most bytes in use during the last tick */
+    size_t peak; /*!< The most bytes ever in use */
+    uint64_t overflows; /*!< The times the current block was full and another one was added */
+} ArenaStats;
+
+extern ArenaStats arena_stats;
+
+void* arena_alloc(size_t size);
+void* arena_calloc(size_t count, size_t size);
+ArenaMark arena_mark(void);
+void arena_release(ArenaMark mark);
+void arena_reset(void);
+void arena_free(void);
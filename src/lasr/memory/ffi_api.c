@@ -0,0 +1,381 @@
+/** \file ffi_api.c
+ *
+ * Memory reads for LuaJIT's FFI.
+ *
+ * Reading memory through the Lua C API stops LuaJIT from compiling the read
+ * loops of the scripts. These functions are instead called through the FFI,
+ * so the loops compile to native code.
+ *
+ * Scripts never get the FFI library itself. A private chunk declares the few
+ * types it needs, reaches the C functions through a table of pointers instead
+ * of symbol lookups, and only hands a `memory` table of Lua functions to the
+ * script. Buffers are only accessed through bounds checked functions, as FFI
+ * arrays aren't.
+ */
+#include "ffi_api.h"
+
+#include "../functions/readAddress.h"
+#include "int64.h"
+#include "read.h"
+#include "read_plan.h"
+#include "src/lasr/utils.h"
+
+#include <errno.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The C functions reachable from the FFI.
+ *
+ * Must match `lasr_ffi_functions_t` in the FFI declarations.
+ */
+typedef struct FfiApiFunctions {
+    int32_t (*read)(uint64_t address, void* buffer, size_t size);
+    size_t (*readv)(uint8_t* buffer, size_t length, FfiReadRequest* requests, size_t capacity, size_t count);
+    int8_t (*read_i8)(uint64_t address, int32_t* err);
+    uint8_t (*read_u8)(uint64_t address, int32_t* err);
+    int16_t (*read_i16)(uint64_t address, int32_t* err);
+    uint16_t (*read_u16)(uint64_t address, int32_t* err);
+    int32_t (*read_i32)(uint64_t address, int32_t* err);
+    uint32_t (*read_u32)(uint64_t address, int32_t* err);
+    int64_t (*read_i64)(uint64_t address, int32_t* err);
+    uint64_t (*read_u64)(uint64_t address, int32_t* err);
+    float (*read_f32)(uint64_t address, int32_t* err);
+    double (*read_f64)(uint64_t address, int32_t* err);
+    bool (*read_bool)(uint64_t address, int32_t* err);
+} FfiApiFunctions;
+
+static const FfiApiFunctions ffi_functions = {
+    .read = ffiapi_read,
+    .readv = ffiapi_readv,
+    .read_i8 = read_memory_int8_t,
+    .read_u8 = read_memory_uint8_t,
+    .read_i16 = read_memory_int16_t,
+    .read_u16 = read_memory_uint16_t,
+    .read_i32 = read_memory_int32_t,
+    .read_u32 = read_memory_uint32_t,
+    .read_i64 = read_memory_int64_t,
+    .read_u64 = read_memory_uint64_t,
+    .read_f32 = read_memory_float,
+    .read_f64 = read_memory_double,
+    .read_bool = read_memory_bool,
+};
+
+/**
+ * Chains reused across the batches, grown as needed.
+ *
+ * LASR runs on a single thread, so there's no need to guard this.
+ */
+static struct {
+    ReadChain* chains;
+    size_t capacity;
+} scratch = { 0 };
+
+/**
+ * Source of the chunk building the `memory` table, one line per element as
+ * ISO C limits the length of string literals.
+ *
+ * The chunk receives the FFI library and a pointer to `ffi_functions`, and
+ * returns the `memory` table and the 64-bit integer helpers.
+ */
+static const char* const ffi_api_source[] = {
+    "local ffi, functions = ...\n",
+    "ffi.cdef([[\n",
+    "typedef struct lasr_read_request {\n",
+    "    uint64_t address;\n",
+    "    uint32_t offset;\n",
+    "    uint32_t size;\n",
+    "    int32_t error;\n",
+    "} lasr_read_request_t;\n",
+    "typedef struct lasr_ffi_functions {\n",
+    "    int32_t (*read)(uint64_t address, void* buffer, size_t size);\n",
+    "    size_t (*readv)(uint8_t* buffer, size_t length, lasr_read_request_t* requests, size_t capacity, size_t count);\n",
+    "    int8_t (*read_i8)(uint64_t address, int32_t* err);\n",
+    "    uint8_t (*read_u8)(uint64_t address, int32_t* err);\n",
+    "    int16_t (*read_i16)(uint64_t address, int32_t* err);\n",
+    "    uint16_t (*read_u16)(uint64_t address, int32_t* err);\n",
+    "    int32_t (*read_i32)(uint64_t address, int32_t* err);\n",
+    "    uint32_t (*read_u32)(uint64_t address, int32_t* err);\n",
+    "    int64_t (*read_i64)(uint64_t address, int32_t* err);\n",
+    "    uint64_t (*read_u64)(uint64_t address, int32_t* err);\n",
+    "    float (*read_f32)(uint64_t address, int32_t* err);\n",
+    "    double (*read_f64)(uint64_t address, int32_t* err);\n",
+    "    bool (*read_bool)(uint64_t address, int32_t* err);\n",
+    "} lasr_ffi_functions_t;\n",
+    "]])\n",
+    "\n",
+    "local C = ffi.cast(\"const lasr_ffi_functions_t*\", functions)\n",
+    "local cast, new, ffi_string = ffi.cast, ffi.new, ffi.string\n",
+    "local error, type, tonumber, setmetatable, floor = error, type, tonumber, setmetatable, math.floor\n",
+    "local err = new(\"int32_t[1]\")\n",
+    "\n",
+    "-- 64-bit integers handed to the scripts, see int64.c\n",
+    "local int64_t, uint64_t = ffi.typeof(\"int64_t\"), ffi.typeof(\"uint64_t\")\n",
+    "local rshift, arshift = bit.rshift, bit.arshift\n",
+    "local int64 = {\n",
+    "    int64 = int64_t, uint64 = uint64_t,\n",
+    "    band = bit.band, bor = bit.bor, bxor = bit.bxor, bnot = bit.bnot, lshift = bit.lshift,\n",
+    "    -- Like b_rshift on numbers, signed values keep their sign\n",
+    "    rshift = function(value, count)\n",
+    "        if ffi.istype(uint64_t, value) then\n",
+    "            return rshift(value, count)\n",
+    "        end\n",
+    "        return arshift(value, count)\n",
+    "    end,\n",
+    "}\n",
+    "\n",
+    "local types = {\n",
+    "    i8 = \"int8_t\", u8 = \"uint8_t\", i16 = \"int16_t\", u16 = \"uint16_t\", i32 = \"int32_t\", u32 = \"uint32_t\",\n",
+    "    i64 = \"int64_t\", u64 = \"uint64_t\", f32 = \"float\", f64 = \"double\",\n",
+    "}\n",
+    "local pointers = {}\n",
+    "for name, ctype in pairs(types) do\n",
+    "    pointers[name] = { ffi.typeof(ctype .. \"*\"), ffi.sizeof(ctype) }\n",
+    "end\n",
+    "\n",
+    "-- The raw cdata behind the buffers and requests given to the scripts, never exposed\n",
+    "local owners = setmetatable({}, { __mode = \"k\" })\n",
+    "\n",
+    "local memory = {}\n",
+    "\n",
+    "for name in pairs(types) do\n",
+    "    local read = C[\"read_\" .. name]\n",
+    "    memory[name] = function(address)\n",
+    "        err[0] = 0\n",
+    "        local value = read(address, err)\n",
+    "        if err[0] ~= 0 then\n",
+    "            return nil\n",
+    "        end\n",
+    "        return value\n",
+    "    end\n",
+    "end\n",
+    "memory.bool = function(address)\n",
+    "    err[0] = 0\n",
+    "    local value = C.read_bool(address, err)\n",
+    "    if err[0] ~= 0 then\n",
+    "        return nil\n",
+    "    end\n",
+    "    return value\n",
+    "end\n",
+    "\n",
+    "-- Written so that NaN, which fails every comparison, is rejected\n",
+    "local function is_integer(value)\n",
+    "    return type(value) == \"number\" and value == floor(value)\n",
+    "end\n",
+    "\n",
+    "local function check(offset, size, length)\n",
+    "    if not (is_integer(offset) and is_integer(size) and offset >= 0 and size >= 0 and offset + size <= length) then\n",
+    "        error(\"out of the buffer bounds\", 3)\n",
+    "    end\n",
+    "end\n",
+    "\n",
+    "function memory.buffer(length)\n",
+    "    if not (is_integer(length) and length >= 1) then\n",
+    "        error(\"the buffer size must be a positive number\", 2)\n",
+    "    end\n",
+    "    local data = new(\"uint8_t[?]\", length)\n",
+    "    local buffer = { length = length }\n",
+    "    function buffer:read(address, offset, size)\n",
+    "        offset = offset or 0\n",
+    "        size = size or length - offset\n",
+    "        check(offset, size, length)\n",
+    "        return C.read(address, data + offset, size) == 0\n",
+    "    end\n",
+    "    for name, pointer in pairs(pointers) do\n",
+    "        local pointer_type, size = pointer[1], pointer[2]\n",
+    "        buffer[name] = function(self, offset)\n",
+    "            check(offset, size, length)\n",
+    "            return cast(pointer_type, data + offset)[0]\n",
+    "        end\n",
+    "    end\n",
+    "    function buffer:bytes(offset, size)\n",
+    "        check(offset, size, length)\n",
+    "        return ffi_string(data + offset, size)\n",
+    "    end\n",
+    "    function buffer:string(offset, size)\n",
+    "        check(offset, size, length)\n",
+    "        local last = offset\n",
+    "        while last < offset + size and data[last] ~= 0 do\n",
+    "            last = last + 1\n",
+    "        end\n",
+    "        return ffi_string(data + offset, last - offset)\n",
+    "    end\n",
+    "    owners[buffer] = { data, length }\n",
+    "    return buffer\n",
+    "end\n",
+    "\n",
+    "function memory.requests(count)\n",
+    "    if not (is_integer(count) and count >= 1) then\n",
+    "        error(\"the number of requests must be a positive number\", 2)\n",
+    "    end\n",
+    "    local items = new(\"lasr_read_request_t[?]\", count)\n",
+    "    local requests = { count = count }\n",
+    "    function requests:set(i, address, offset, size)\n",
+    "        if not (is_integer(i) and i >= 1 and i <= count) then\n",
+    "            error(\"request index out of bounds\", 2)\n",
+    "        end\n",
+    "        local item = items[i - 1]\n",
+    "        item.address, item.offset, item.size, item.error = address, offset, size, 0\n",
+    "    end\n",
+    "    function requests:error(i)\n",
+    "        if not (is_integer(i) and i >= 1 and i <= count) then\n",
+    "            error(\"request index out of bounds\", 2)\n",
+    "        end\n",
+    "        return items[i - 1].error\n",
+    "    end\n",
+    "    owners[requests] = { items, count }\n",
+    "    return requests\n",
+    "end\n",
+    "\n",
+    "function memory.readv(buffer, requests, count)\n",
+    "    local b, r = owners[buffer], owners[requests]\n",
+    "    if not b or not r then\n",
+    "        error(\"expected a buffer and requests created by memory.buffer and memory.requests\", 2)\n",
+    "    end\n",
+    "    count = count or r[2]\n",
+    "    if not (is_integer(count) and count >= 0 and count <= r[2]) then\n",
+    "        error(\"request count out of bounds\", 2)\n",
+    "    end\n",
+    "    return tonumber(C.readv(b[1], b[2], r[1], r[2], count))\n",
+    "end\n",
+    "\n",
+    "return memory, int64\n",
+    NULL
+};
+
+/**
+ * lua_Reader handing over the chunk source line by line.
+ *
+ * @param L The Lua State
+ * @param data Pointer to the next line.
+ * @param[out] size The length of the line.
+ *
+ * @return The line, NULL at the end of the source.
+ */
+static const char* read_source_line(lua_State* L, void* data, size_t* size)
+{
+    const char* const** next = data;
+    const char* line = **next;
+    if (line) {
+        *size = strlen(line);
+        (*next)++;
+    }
+    return line;
+}
+
+/**
+ * Reads the game memory into a buffer.
+ *
+ * @param address Where to read in the game memory.
+ * @param buffer Where to store the bytes.
+ * @param size How many bytes to read.
+ *
+ * @return Zero on success, the errno of the failure otherwise.
+ */
+int32_t ffiapi_read(uint64_t address, void* buffer, size_t size)
+{
+    struct iovec local = { .iov_base = buffer, .iov_len = size };
+    struct iovec remote = { .iov_base = (void*)(uintptr_t)address, .iov_len = size };
+    ssize_t n_read = memory_readv(process.pid, &local, 1, &remote, 1);
+    if (n_read == -1) {
+        return (int32_t)errno;
+    }
+    return (size_t)n_read == size ? 0 : EFAULT;
+}
+
+/**
+ * Reads several ranges of the game memory into parts of a buffer, with as
+ * few syscalls as possible.
+ *
+ * @param buffer Where to store the bytes.
+ * @param length The size of the buffer.
+ * @param requests The ranges to read, their `error` is set.
+ * @param capacity The size of the `requests` array.
+ * @param count The number of requests to read, at most `capacity`.
+ *
+ * @return The number of failed requests, or `count` if it is out of bounds.
+ */
+size_t ffiapi_readv(uint8_t* buffer, size_t length, FfiReadRequest* requests, size_t capacity, size_t count)
+{
+    if (count > capacity) {
+        return count;
+    }
+    if (count > scratch.capacity) {
+        ReadChain* chains = realloc(scratch.chains, count * sizeof(ReadChain));
+        if (!chains) {
+            for (size_t i = 0; i < count; i++) {
+                requests[i].error = ENOMEM;
+            }
+            return count;
+        }
+        scratch.chains = chains;
+        scratch.capacity = count;
+    }
+
+    size_t queued = 0;
+    for (size_t i = 0; i < count; i++) {
+        FfiReadRequest* request = &requests[i];
+        if ((size_t)request->offset + request->size > length) {
+            request->error = EINVAL;
+            continue;
+        }
+        request->error = 0;
+        scratch.chains[queued++] = (ReadChain) {
+            .address = request->address,
+            .type = { READ_TYPE_BYTE_ARRAY, request->size },
+            .value = buffer + request->offset,
+        };
+    }
+    readplan_execute(scratch.chains, queued);
+
+    size_t failed = 0;
+    size_t chain = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (requests[i].error == 0) {
+            requests[i].error = scratch.chains[chain++].error;
+        }
+        if (requests[i].error != 0) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/**
+ * Creates the `memory` global, giving the scripts FFI-based memory reads, and
+ * sets up the 64-bit integers.
+ *
+ * @param L The Lua State
+ *
+ * @return True if the FFI is available and the global was created.
+ */
+bool ffiapi_open(lua_State* L)
+{
+    int64_reset();
+    const char* const* next_line = ffi_api_source;
+    if (lua_load(L, read_source_line, &next_line, "=memory") != LUA_OK) {
+        printf("[memory] Can't load the FFI bindings: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1); // Remove the error message from the stack
+        return false;
+    }
+
+    // The FFI library is only passed to the chunk, never registered as a global
+    lua_pushcfunction(L, luaopen_ffi);
+    if (lua_pcall(L, 0, 1, 0) != LUA_OK) {
+        printf("[memory] The FFI library isn't available: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 2); // Remove the error message and the chunk from the stack
+        return false;
+    }
+    lua_pushlightuserdata(L, (void*)&ffi_functions);
+    if (lua_pcall(L, 2, 2, 0) != LUA_OK) {
+        printf("[memory] Can't create the FFI bindings: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1); // Remove the error message from the stack
+        return false;
+    }
+    int64_open(L);
+    lua_setglobal(L, "memory");
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <lua.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A read of a batch, filling part of a buffer.
+ *
+ * Must match `lasr_read_request_t` in the FFI declarations.
+ */
+typedef struct FfiReadRequest {
+    uint64_t address; /*!< Where to read in the game memory */
+    uint32_t offset; /*!< Where to store the bytes in the buffer */
+    uint32_t size; /*!< How many bytes to read */
+    int32_t error; /*!< The errno of the failed read, zero on success */
+} FfiReadRequest;
+
+int32_t ffiapi_read(uint64_t address, void* buffer, size_t size);
+size_t ffiapi_readv(uint8_t* buffer, size_t length, FfiReadRequest* requests, size_t capacity, size_t count);
+bool ffiapi_open(lua_State* L);
@@ -0,0 +1,199 @@
+/** \file int64.c
+ *
+ * 64-bit integers for the auto splitters.
+ *
+ * LuaJIT numbers are doubles, which only hold integers up to 2^53 exactly, so
+ * 64-bit values and pointers are handed to the scripts as LuaJIT `int64_t` and
+ * `uint64_t` cdata instead. The FFI chunk of ffi_api.c creates their types
+ * and the bitwise helpers working on them, the scripts never get the FFI
+ * library itself.
+ *
+ * Without the FFI, 64-bit values fall back to (possibly rounded) numbers.
+ */
+#include "int64.h"
+
+#include <lauxlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * The type of cdata values returned by lua_type, LuaJIT's lua.h doesn't name it.
+ */
+#define INT64_LUA_TCDATA 10
+
+static int int64_ref = LUA_NOREF; /*!< Registry reference to the `int64_t` type */
+static int uint64_ref = LUA_NOREF; /*!< Registry reference to the `uint64_t` type */
+static int helpers_ref = LUA_NOREF; /*!< Registry reference to the helpers table */
+
+/**
+ * Forgets the helpers of the previous Lua State, falling back to numbers until
+ * int64_open is called.
+ */
+void int64_reset(void)
+{
+    int64_ref = LUA_NOREF;
+    uint64_ref = LUA_NOREF;
+    helpers_ref = LUA_NOREF;
+}
+
+/**
+ * Takes the helpers table created by the FFI chunk from the top of the stack.
+ *
+ * The table holds the `int64` and `uint64` types and the bitwise functions
+ * accepting them. Must be called for every new Lua State, after which the
+ * 64-bit values are pushed as cdata.
+ *
+ * @param L The Lua State
+ */
+void int64_open(lua_State* L)
+{
+    lua_getfield(L, -1, "int64");
+    int64_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_getfield(L, -1, "uint64");
+    uint64_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    helpers_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+/**
+ * Pushes a new cdata of a 64-bit integer type holding a value.
+ *
+ * @param L The Lua State
+ * @param type_ref Registry reference to the type.
+ * @param value The 8 bytes of the value.
+ */
+static void push_boxed(lua_State* L, int type_ref, const void* value)
+{
+    // Calling the type creates a zeroed cdata, whose payload lua_topointer returns
+    lua_rawgeti(L, LUA_REGISTRYINDEX, type_ref);
+    lua_call(L, 0, 1);
+    const void* payload = lua_topointer(L, -1);
+    memcpy((void*)payload, value, sizeof(uint64_t));
+}
+
+/**
+ * Pushes a signed 64-bit integer, without losing precision.
+ *
+ * @param L The Lua State
+ * @param value The value.
+ */
+void int64_push(lua_State* L, int64_t value)
+{
+    if (int64_ref == LUA_NOREF) {
+        lua_pushnumber(L, (lua_Number)value);
+        return;
+    }
+    push_boxed(L, int64_ref, &value);
+}
+
+/**
+ * Pushes an unsigned 64-bit integer, without losing precision.
+ *
+ * @param L The Lua State
+ * @param value The value.
+ */
+void int64_pushUnsigned(lua_State* L, uint64_t value)
+{
+    if (uint64_ref == LUA_NOREF) {
+        lua_pushnumber(L, (lua_Number)value);
+        return;
+    }
+    push_boxed(L, uint64_ref, &value);
+}
+
+/**
+ * Checks whether a value is a boxed 64-bit integer.
+ *
+ * The scripts can't reach the FFI, so the only cdata they ever hold are the
+ * `int64_t` and `uint64_t` values created by this file and the arithmetic on
+ * them.
+ *
+ * @param L The Lua State
+ * @param index The stack index of the value.
+ *
+ * @return True if the value is an `int64_t` or `uint64_t` cdata.
+ */
+bool int64_isBoxed(lua_State* L, int index)
+{
+    return lua_type(L, index) == INT64_LUA_TCDATA;
+}
+
+/**
+ * Gets an integer argument, either a number or a boxed 64-bit integer.
+ *
+ * Negative values are returned in two's complement, so they can be added to
+ * addresses as offsets. Numbers that aren't finite or don't fit in 64 bits
+ * are rejected, converting them would be undefined behaviour.
+ *
+ * @param L The Lua State
+ * @param index The stack index of the value.
+ * @param[out] value The value, zero if it isn't an integer.
+ *
+ * @return True if the value is a number between -2^63 and 2^64 (excluded), a
+ * string convertible to such a number or a boxed 64-bit integer.
+ */
+bool int64_get(lua_State* L, int index, uint64_t* value)
+{
+    if (int64_isBoxed(L, index)) {
+        memcpy(value, lua_topointer(L, index), sizeof(uint64_t));
+        return true;
+    }
+    if (!lua_isnumber(L, index)) {
+        *value = 0;
+        return false;
+    }
+    lua_Number number = lua_tonumber(L, index);
+    // Also false for NaN
+    if (!(number >= -9223372036854775808.0 && number < 18446744073709551616.0)) {
+        *value = 0;
+        return false;
+    }
+    *value = number < 0 ? (uint64_t)(int64_t)number : (uint64_t)number;
+    return true;
+}
+
+/**
+ * Finds the first argument of a range that int64_get rejects.
+ *
+ * @param L The Lua State
+ * @param first The stack index of the first argument.
+ * @param last The stack index of the last argument.
+ *
+ * @return The stack index of the invalid argument, 0 if they are all valid.
+ */
+int int64_findInvalid(lua_State* L, int first, int last)
+{
+    uint64_t value;
+    for (int i = first; i <= last; i++) {
+        if (!int64_get(L, i, &value)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Calls one of the bitwise helpers with all the values on the stack.
+ *
+ * @param L The Lua State
+ * @param name The name of the calling Lua function, for errors.
+ * @param helper The helper to call: `band`, `bor`, `bxor`, `bnot`, `lshift` or `rshift`.
+ *
+ * @return The number of results: 1, or 0 on error.
+ */
+int int64_call(lua_State* L, const char* name, const char* helper)
+{
+    if (helpers_ref == LUA_NOREF) {
+        printf("[%s] 64-bit integers need LuaJIT's FFI\n", name);
+        return 0;
+    }
+    int args = lua_gettop(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, helpers_ref);
+    lua_getfield(L, -1, helper);
+    lua_replace(L, -2);
+    lua_insert(L, 1);
+    if (lua_pcall(L, args, 1, 0) != LUA_OK) {
+        printf("[%s] %s\n", name, lua_tostring(L, -1));
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <lua.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+void int64_reset(void);
+void int64_open(lua_State* L);
+void int64_push(lua_State* L, int64_t value);
+void int64_pushUnsigned(lua_State* L, uint64_t value);
+bool int64_isBoxed(lua_State* L, int index);
+bool int64_get(lua_State* L, int index, uint64_t* value);
+int int64_findInvalid(lua_State* L, int first, int last);
+int int64_call(lua_State* L, const char* name, const char* helper);
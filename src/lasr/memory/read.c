@@ -0,0 +1,60 @@
+/** \file read.c
+ *
+ * Single entry point for reading the memory of the game.
+ *
+ * Every process_vm_readv goes through memory_readv, so the reads can be
+ * counted and served from the per-tick snapshot in one place.
+ */
+#include "read.h"
+
+#include "snapshot.h"
+
+#include "src/lasr/utils.h"
+
+MemoryReadCounters memory_read_counters;
+
+/**
+ * Reads the memory of a process directly, counting the syscall and the bytes read.
+ *
+ * Takes the same arguments as process_vm_readv, without the flags.
+ *
+ * @param pid The process to read from.
+ * @param local The buffers receiving the data.
+ * @param local_count The number of elements in `local`.
+ * @param remote The memory ranges to read.
+ * @param remote_count The number of elements in `remote`.
+ *
+ * @return The number of bytes read, -1 on error with errno set.
+ */
+ssize_t memory_readvUncached(pid_t pid, const struct iovec* local, unsigned long local_count, const struct iovec* remote, unsigned long remote_count)
+{
+    ssize_t n_read = process_vm_readv(pid, local, local_count, remote, remote_count, 0);
+    atomic_fetch_add_explicit(&memory_read_counters.syscalls, 1, memory_order_relaxed);
+    if (n_read > 0) {
+        atomic_fetch_add_explicit(&memory_read_counters.bytes, (uint_fast64_t)n_read, memory_order_relaxed);
+    }
+    return n_read;
+}
+
+/**
+ * Reads the memory of a process, from the snapshot of the current tick when
+ * one is active on the calling thread.
+ *
+ * Takes the same arguments as process_vm_readv, without the flags.
+ *
+ * @param pid The process to read from.
+ * @param local The buffers receiving the data.
+ * @param local_count The number of elements in `local`.
+ * @param remote The memory ranges to read.
+ * @param remote_count The number of elements in `remote`.
+ *
+ * @return The number of bytes read, -1 on error with errno set.
+ */
+ssize_t memory_readv(pid_t pid, const struct iovec* local, unsigned long local_count, const struct iovec* remote, unsigned long remote_count)
+{
+    ssize_t n_read;
+    if (snapshot_readv(pid, local, local_count, remote, remote_count, &n_read)) {
+        return n_read;
+    }
+    return memory_readvUncached(pid, local, local_count, remote, remote_count);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ * Counters of the reads of the game memory, shared by every thread reading it.
+ */
+typedef struct MemoryReadCounters {
+    atomic_uint_fast64_t syscalls; /*!< The number of process_vm_readv calls */
+    atomic_uint_fast64_t bytes; /*!< The number of bytes read */
+} MemoryReadCounters;
+
+extern MemoryReadCounters memory_read_counters;
+
+ssize_t memory_readvUncached(pid_t pid, const struct iovec* local, unsigned long local_count, const struct iovec* remote, unsigned long remote_count);
+ssize_t memory_readv(pid_t pid, const struct iovec* local, unsigned long local_count, const struct iovec* remote, unsigned long remote_count);
@@ -0,0 +1,421 @@
+/** \file read_plan.c
+ *
+ * Batched pointer chain resolution.
+ *
+ * Independent pointer chains are walked level by level: every level issues a
+ * single vectored process_vm_readv with one iovec per chain, so the number of
+ * syscalls grows with the deepest chain instead of the total number of hops.
+ */
+#include "read_plan.h"
+
+#include "int64.h"
+#include "read.h"
+#include "src/lasr/utils.h"
+
+#include <errno.h>
+#include <lauxlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Maximum amount of iovecs accepted by a single process_vm_readv call (UIO_MAXIOV).
+ */
+#define READPLAN_MAX_IOV 1024
+
+/**
+ * Scratch space reused across executions, grown as needed.
+ *
+ * LASR runs on a single thread, so there's no need to guard this.
+ */
+static struct {
+    struct iovec* local;
+    struct iovec* remote;
+    size_t* owners;
+    size_t capacity;
+} scratch = { 0 };
+
+/**
+ * Simple type names and their parsed counterpart.
+ */
+static const struct {
+    const char* name;
+    ReadType type;
+} simple_types[] = {
+    { "sbyte", { READ_TYPE_SBYTE, sizeof(int8_t) } },
+    { "byte", { READ_TYPE_BYTE, sizeof(uint8_t) } },
+    { "short", { READ_TYPE_SHORT, sizeof(int16_t) } },
+    { "ushort", { READ_TYPE_USHORT, sizeof(uint16_t) } },
+    { "int", { READ_TYPE_INT, sizeof(int32_t) } },
+    { "uint", { READ_TYPE_UINT, sizeof(uint32_t) } },
+    { "long", { READ_TYPE_LONG, sizeof(int64_t) } },
+    { "ulong", { READ_TYPE_ULONG, sizeof(uint64_t) } },
+    { "float", { READ_TYPE_FLOAT, sizeof(float) } },
+    { "double", { READ_TYPE_DOUBLE, sizeof(double) } },
+    { "bool", { READ_TYPE_BOOL, sizeof(bool) } },
+};
+
+/**
+ * Parses a readAddress type string.
+ *
+ * @param name The type string, like "int", "string32", "byte16", "raw64",
+ * "wstring32" or "float[8]".
+ * @param[out] out Where to store the parsed type.
+ *
+ * @return True if the type is valid, false otherwise.
+ */
+bool readplan_parseType(const char* name, ReadType* out)
+{
+    const char* bracket = strchr(name, '[');
+    size_t name_length = bracket ? (size_t)(bracket - name) : strlen(name);
+    for (size_t i = 0; i < sizeof(simple_types) / sizeof(simple_types[0]); i++) {
+        const ReadType* simple = &simple_types[i].type;
+        if (strncmp(name, simple_types[i].name, name_length) != 0 || simple_types[i].name[name_length] != '\0') {
+            continue;
+        }
+        if (!bracket) {
+            *out = *simple;
+            return true;
+        }
+
+        // Arrays of simple types: "int[16]"
+        char* end;
+        long count = strtol(bracket + 1, &end, 10);
+        if (count < 1 || (size_t)count > READPLAN_MAX_VALUE_SIZE / simple->size || strcmp(end, "]") != 0) {
+            return false;
+        }
+        *out = (ReadType) {
+            .tag = READ_TYPE_ARRAY,
+            .size = count * simple->size,
+            .element = simple->tag,
+            .element_size = simple->size,
+        };
+        return true;
+    }
+
+    // Sized types: "string32", "byte16"...
+    static const struct {
+        const char* prefix;
+        ReadTypeTag tag;
+        int min_count; /*!< The smallest valid count */
+        size_t unit; /*!< The bytes per counted unit */
+    } sized_types[] = {
+        { "string", READ_TYPE_STRING, 2, sizeof(char) },
+        { "wstring", READ_TYPE_WSTRING, 2, sizeof(uint16_t) },
+        { "byte", READ_TYPE_BYTE_ARRAY, 1, sizeof(uint8_t) },
+        { "raw", READ_TYPE_RAW, 1, sizeof(uint8_t) },
+    };
+    for (size_t i = 0; i < sizeof(sized_types) / sizeof(sized_types[0]); i++) {
+        size_t prefix_length = strlen(sized_types[i].prefix);
+        if (strncmp(name, sized_types[i].prefix, prefix_length) != 0) {
+            continue;
+        }
+        int count = atoi(name + prefix_length);
+        if (count < sized_types[i].min_count || (size_t)count > READPLAN_MAX_VALUE_SIZE / sized_types[i].unit) {
+            return false;
+        }
+        *out = (ReadType) {
+            .tag = sized_types[i].tag,
+            .size = count * sized_types[i].unit,
+        };
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Decides how wide the pointer stored at an address is.
+ *
+ * Uses the pointer size of the process when known. Otherwise mirrors the
+ * readAddress fallback: addresses that fit in 32 bits are assumed to belong
+ * to a 32 bit process.
+ *
+ * @param address The address the pointer is stored at.
+ *
+ * @return The size of the pointer, in bytes.
+ */
+static size_t pointer_width(uint64_t address)
+{
+    if (process.pointer_size) {
+        return process.pointer_size;
+    }
+    return address <= UINT32_MAX ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+/**
+ * Makes sure the scratch space can hold at least `count` iovecs.
+ *
+ * @param count The number of iovecs needed.
+ *
+ * @return True on success, false if the allocation failed.
+ */
+static bool ensure_scratch(size_t count)
+{
+    if (count <= scratch.capacity) {
+        return true;
+    }
+    struct iovec* local = realloc(scratch.local, count * sizeof(struct iovec));
+    if (local) {
+        scratch.local = local;
+    }
+    struct iovec* remote = realloc(scratch.remote, count * sizeof(struct iovec));
+    if (remote) {
+        scratch.remote = remote;
+    }
+    size_t* owners = realloc(scratch.owners, count * sizeof(size_t));
+    if (owners) {
+        scratch.owners = owners;
+    }
+    if (!local || !remote || !owners) {
+        return false;
+    }
+    scratch.capacity = count;
+    return true;
+}
+
+/**
+ * Reads all the queued iovecs, splitting them in as few syscalls as possible.
+ *
+ * process_vm_readv stops at the first iovec that can't be read, so a fault
+ * only marks the chain that caused it as failed and the read restarts from
+ * the following iovec.
+ *
+ * @param chains The chains owning the iovecs.
+ * @param count The number of queued iovecs.
+ *
+ * @return The number of syscalls issued.
+ */
+static size_t read_queued(ReadChain* chains, size_t count)
+{
+    size_t syscalls = 0;
+    size_t first = 0;
+    while (first < count) {
+        size_t batch = count - first;
+        if (batch > READPLAN_MAX_IOV) {
+            batch = READPLAN_MAX_IOV;
+        }
+
+        ssize_t n_read = memory_readv(process.pid, &scratch.local[first], batch, &scratch.remote[first], batch);
+        syscalls++;
+
+        if (n_read == -1) {
+            int32_t err = (int32_t)errno;
+            if (err != EFAULT) {
+                // The whole process is unreadable, no point in retrying
+                for (; first < count; first++) {
+                    chains[scratch.owners[first]].error = err;
+                }
+                break;
+            }
+            chains[scratch.owners[first]].error = err;
+            first++;
+            continue;
+        }
+
+        size_t remaining = n_read;
+        size_t done = 0;
+        while (done < batch && remaining >= scratch.remote[first + done].iov_len) {
+            remaining -= scratch.remote[first + done].iov_len;
+            done++;
+        }
+        first += done;
+        if (done < batch) {
+            // Short read: the iovec the read stopped at is the faulty one
+            chains[scratch.owners[first]].error = EFAULT;
+            first++;
+        }
+    }
+    return syscalls;
+}
+
+/**
+ * Resolves a set of independent pointer chains.
+ *
+ * On every level, chains that still have offsets left dereference their
+ * current address, while chains that ran out of offsets read their final value.
+ * Chains must start with `error` set to zero, chains whose `error` is set after
+ * execution didn't produce a value.
+ *
+ * @param chains The chains to resolve.
+ * @param count The number of chains.
+ *
+ * @return The number of process_vm_readv syscalls issued.
+ */
+size_t readplan_execute(ReadChain* chains, size_t count)
+{
+    if (!ensure_scratch(count)) {
+        for (size_t i = 0; i < count; i++) {
+            chains[i].error = ENOMEM;
+        }
+        return 0;
+    }
+
+    size_t syscalls = 0;
+    for (int level = 0;; level++) {
+        size_t queued = 0;
+        for (size_t i = 0; i < count; i++) {
+            ReadChain* chain = &chains[i];
+            if (chain->error != 0 || level > chain->offsets_count) {
+                continue;
+            }
+
+            if (level < chain->offsets_count) {
+                // Pointers are little endian, reading 4 bytes into a zeroed
+                // 8 byte integer gives back the 32 bit pointer
+                chain->pointer = 0;
+                scratch.local[queued].iov_base = &chain->pointer;
+                scratch.local[queued].iov_len = pointer_width(chain->address);
+            } else {
+                scratch.local[queued].iov_base = chain->value;
+                scratch.local[queued].iov_len = chain->type.size;
+            }
+            scratch.remote[queued].iov_base = (void*)(uintptr_t)chain->address;
+            scratch.remote[queued].iov_len = scratch.local[queued].iov_len;
+            scratch.owners[queued] = i;
+            queued++;
+        }
+
+        if (queued == 0) {
+            break;
+        }
+
+        syscalls += read_queued(chains, queued);
+
+        for (size_t q = 0; q < queued; q++) {
+            ReadChain* chain = &chains[scratch.owners[q]];
+            if (chain->error == 0 && level < chain->offsets_count) {
+                chain->address = chain->pointer + chain->offsets[level];
+            }
+        }
+    }
+
+    return syscalls;
+}
+
+/**
+ * Pushes a UTF-16LE string as a UTF-8 Lua string.
+ *
+ * The string stops at the first NUL code unit, unpaired surrogates become
+ * U+FFFD.
+ *
+ * @param L The Lua state.
+ * @param units The UTF-16 code units.
+ * @param count The maximum number of code units.
+ */
+static void push_utf16(lua_State* L, const void* units, size_t count)
+{
+    luaL_Buffer buffer;
+    luaL_buffinit(L, &buffer);
+    for (size_t i = 0; i < count; i++) {
+        uint16_t unit;
+        memcpy(&unit, (const uint8_t*)units + i * sizeof(unit), sizeof(unit));
+        if (unit == 0) {
+            break;
+        }
+
+        uint32_t code_point = unit;
+        if (unit >= 0xD800 && unit <= 0xDFFF) {
+            uint16_t low = 0;
+            if (unit <= 0xDBFF && i + 1 < count) {
+                memcpy(&low, (const uint8_t*)units + (i + 1) * sizeof(low), sizeof(low));
+            }
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                code_point = 0x10000 + ((uint32_t)(unit - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            } else {
+                code_point = 0xFFFD;
+            }
+        }
+
+        if (code_point < 0x80) {
+            luaL_addchar(&buffer, code_point);
+        } else if (code_point < 0x800) {
+            luaL_addchar(&buffer, 0xC0 | (code_point >> 6));
+            luaL_addchar(&buffer, 0x80 | (code_point & 0x3F));
+        } else if (code_point < 0x10000) {
+            luaL_addchar(&buffer, 0xE0 | (code_point >> 12));
+            luaL_addchar(&buffer, 0x80 | ((code_point >> 6) & 0x3F));
+            luaL_addchar(&buffer, 0x80 | (code_point & 0x3F));
+        } else {
+            luaL_addchar(&buffer, 0xF0 | (code_point >> 18));
+            luaL_addchar(&buffer, 0x80 | ((code_point >> 12) & 0x3F));
+            luaL_addchar(&buffer, 0x80 | ((code_point >> 6) & 0x3F));
+            luaL_addchar(&buffer, 0x80 | (code_point & 0x3F));
+        }
+    }
+    luaL_pushresult(&buffer);
+}
+
+/**
+ * Pushes a value read from memory onto the Lua stack.
+ *
+ * @param L The Lua state.
+ * @param type The type of the value.
+ * @param value The raw bytes read from memory.
+ */
+void readplan_pushValue(lua_State* L, const ReadType* type, const void* value)
+{
+    switch (type->tag) {
+        case READ_TYPE_SBYTE:
+            lua_pushinteger(L, *(const int8_t*)value);
+            break;
+        case READ_TYPE_BYTE:
+            lua_pushinteger(L, *(const uint8_t*)value);
+            break;
+        case READ_TYPE_SHORT:
+            lua_pushinteger(L, *(const int16_t*)value);
+            break;
+        case READ_TYPE_USHORT:
+            lua_pushinteger(L, *(const uint16_t*)value);
+            break;
+        case READ_TYPE_INT:
+            lua_pushinteger(L, *(const int32_t*)value);
+            break;
+        case READ_TYPE_UINT:
+            lua_pushinteger(L, *(const uint32_t*)value);
+            break;
+        case READ_TYPE_LONG:
+            int64_push(L, *(const int64_t*)value);
+            break;
+        case READ_TYPE_ULONG:
+            int64_pushUnsigned(L, *(const uint64_t*)value);
+            break;
+        case READ_TYPE_FLOAT:
+            lua_pushnumber(L, *(const float*)value);
+            break;
+        case READ_TYPE_DOUBLE:
+            lua_pushnumber(L, *(const double*)value);
+            break;
+        case READ_TYPE_BOOL:
+            lua_pushboolean(L, *(const uint8_t*)value != 0);
+            break;
+        case READ_TYPE_STRING:
+            // The string might not be terminated inside the buffer
+            lua_pushlstring(L, value, strnlen(value, type->size));
+            break;
+        case READ_TYPE_BYTE_ARRAY:
+            lua_createtable(L, type->size, 0);
+            for (size_t i = 0; i < type->size; i++) {
+                lua_pushinteger(L, ((const uint8_t*)value)[i]);
+                lua_rawseti(L, -2, i + 1);
+            }
+            break;
+        case READ_TYPE_RAW:
+            lua_pushlstring(L, value, type->size);
+            break;
+        case READ_TYPE_WSTRING:
+            push_utf16(L, value, type->size / sizeof(uint16_t));
+            break;
+        case READ_TYPE_ARRAY: {
+            ReadType element = { .tag = type->element, .size = type->element_size };
+            size_t count = type->size / type->element_size;
+            lua_createtable(L, count, 0);
+            for (size_t i = 0; i < count; i++) {
+                readplan_pushValue(L, &element, (const uint8_t*)value + i * element.size);
+                lua_rawseti(L, -2, i + 1);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <lua.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The value types understood by readAddress and the batched readers.
+ */
+typedef enum ReadTypeTag {
+    READ_TYPE_SBYTE, /*!< Signed 8 bit integer */
+    READ_TYPE_BYTE, /*!< Unsigned 8 bit integer */
+    READ_TYPE_SHORT, /*!< Signed 16 bit integer */
+    READ_TYPE_USHORT, /*!< Unsigned 16 bit integer */
+    READ_TYPE_INT, /*!< Signed 32 bit integer */
+    READ_TYPE_UINT, /*!< Unsigned 32 bit integer */
+    READ_TYPE_LONG, /*!< Signed 64 bit integer */
+    READ_TYPE_ULONG, /*!< Unsigned 64 bit integer */
+    READ_TYPE_FLOAT, /*!< 32 bit floating point number */
+    READ_TYPE_DOUBLE, /*!< 64 bit floating point number */
+    READ_TYPE_BOOL, /*!< Boolean */
+    READ_TYPE_STRING, /*!< NUL-terminated string of at most `size` bytes */
+    READ_TYPE_BYTE_ARRAY, /*!< Array of `size` unsigned bytes */
+    READ_TYPE_RAW, /*!< `size` bytes, as a Lua string */
+    READ_TYPE_WSTRING, /*!< NUL-terminated UTF-16 string of at most `size / 2` code units */
+    READ_TYPE_ARRAY, /*!< Array of `size / element_size` values of type `element` */
+} ReadTypeTag;
+
+/**
+ * The largest value a single read can return, in bytes.
+ */
+#define READPLAN_MAX_VALUE_SIZE (1 << 24)
+
+/**
+ * A parsed readAddress type string.
+ */
+typedef struct ReadType {
+    ReadTypeTag tag; /*!< What the read bytes represent */
+    size_t size; /*!< How many bytes have to be read */
+    ReadTypeTag element; /*!< The type of the elements of a READ_TYPE_ARRAY */
+    size_t element_size; /*!< The size of the elements of a READ_TYPE_ARRAY */
+} ReadType;
+
+/**
+ * A single pointer chain to be resolved by readplan_execute.
+ *
+ * The chain starts at `address`, every offset dereferences the current address
+ * as a pointer and adds the offset to it, then `type.size` bytes are read at
+ * the final address into `value`.
+ */
+typedef struct ReadChain {
+    uint64_t address; /*!< The current address, updated while the chain is walked */
+    const int64_t* offsets; /*!< The offsets to add after each dereference */
+    int offsets_count; /*!< The number of elements in `offsets` */
+    ReadType type; /*!< The type of the final value */
+    void* value; /*!< Destination of the final value, `type.size` bytes big */
+    uint64_t pointer; /*!< Scratch space for the dereferenced pointers */
+    int32_t error; /*!< The errno of the failed read, zero on success */
+} ReadChain;
+
+bool readplan_parseType(const char* name, ReadType* out);
+size_t readplan_execute(ReadChain* chains, size_t count);
+void readplan_pushValue(lua_State* L, const ReadType* type, const void* value);
@@ -0,0 +1,193 @@
+/** \file snapshot.c
+ *
+ * Per-tick snapshot of the game memory.
+ *
+ * While a snapshot is active, reads are served from lines of the game memory
+ * fetched on first use and kept until the end of the tick, so reading several
+ * fields of the same struct costs a single syscall. Every line missing for a
+ * read is fetched with the same process_vm_readv.
+ *
+ * Reads that can't be served as a whole (too large, conflicting lines or
+ * unreadable memory) go straight to the game memory, so failures behave
+ * exactly as without the snapshot.
+ *
+ * The snapshot only applies to the thread that began it, reads from other
+ * threads (like the signature scan workers) are never cached.
+ */
+#include "snapshot.h"
+
+#include "read.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * A cached line of the game memory.
+ */
+typedef struct SnapshotLine {
+    uintptr_t address; /*!< The address of the first byte of the line */
+    uint32_t generation; /*!< The snapshot the line was fetched in, stale if not the current one */
+    uint8_t bytes[SNAPSHOT_LINE_SIZE];
+} SnapshotLine;
+
+static _Thread_local bool active = false; /*!< True if a snapshot is active on this thread */
+static pid_t snapshot_pid; /*!< The process the snapshot is taken from */
+static uint32_t generation = 0; /*!< The current snapshot, lines of older ones are stale */
+static SnapshotLine lines[SNAPSHOT_LINES];
+
+/**
+ * Starts a snapshot on the calling thread, all the previously cached lines
+ * becoming stale.
+ *
+ * @param pid The process to take the snapshot of.
+ */
+void snapshot_begin(pid_t pid)
+{
+    generation++;
+    if (generation == 0) {
+        // Line generations wrapped around, forget them all
+        memset(lines, 0, sizeof(lines));
+        generation = 1;
+    }
+    snapshot_pid = pid;
+    active = true;
+}
+
+/**
+ * Stops the snapshot of the calling thread, reading the game memory directly again.
+ */
+void snapshot_end(void)
+{
+    active = false;
+}
+
+/**
+ * Gets the slot of the line starting at an address.
+ */
+static SnapshotLine* line_slot(uintptr_t address)
+{
+    return &lines[(address / SNAPSHOT_LINE_SIZE) % SNAPSHOT_LINES];
+}
+
+/**
+ * Makes sure all the lines covering a read are cached, fetching the missing
+ * ones with a single syscall.
+ *
+ * @return True if the read can be served from the cached lines.
+ */
+static bool fetch_lines(const struct iovec* remote, unsigned long remote_count)
+{
+    uintptr_t wanted[SNAPSHOT_MAX_READ_LINES];
+    size_t wanted_count = 0;
+    SnapshotLine* slots[SNAPSHOT_MAX_READ_LINES];
+    struct iovec local_iov[SNAPSHOT_MAX_READ_LINES];
+    struct iovec remote_iov[SNAPSHOT_MAX_READ_LINES];
+    size_t missing = 0;
+
+    for (unsigned long i = 0; i < remote_count; i++) {
+        if (remote[i].iov_len == 0) {
+            continue;
+        }
+        uintptr_t start = (uintptr_t)remote[i].iov_base;
+        uintptr_t last = start + remote[i].iov_len - 1;
+        if (last < start) {
+            return false;
+        }
+        for (uintptr_t line = start - start % SNAPSHOT_LINE_SIZE; line <= last; line += SNAPSHOT_LINE_SIZE) {
+            SnapshotLine* slot = line_slot(line);
+            bool seen = false;
+            for (size_t j = 0; j < wanted_count; j++) {
+                if (line_slot(wanted[j]) == slot) {
+                    if (wanted[j] != line) {
+                        // Two lines of this read share a slot
+                        return false;
+                    }
+                    seen = true;
+                    break;
+                }
+            }
+            if (seen) {
+                continue;
+            }
+            if (wanted_count == SNAPSHOT_MAX_READ_LINES) {
+                return false;
+            }
+            wanted[wanted_count++] = line;
+
+            if (slot->generation != generation || slot->address != line) {
+                slots[missing] = slot;
+                local_iov[missing] = (struct iovec) { .iov_base = slot->bytes, .iov_len = SNAPSHOT_LINE_SIZE };
+                remote_iov[missing] = (struct iovec) { .iov_base = (void*)line, .iov_len = SNAPSHOT_LINE_SIZE };
+                missing++;
+            }
+            if (line > UINTPTR_MAX - SNAPSHOT_LINE_SIZE) {
+                break;
+            }
+        }
+    }
+
+    if (missing == 0) {
+        return true;
+    }
+    ssize_t n_read = memory_readvUncached(snapshot_pid, local_iov, missing, remote_iov, missing);
+    for (size_t i = 0; i < missing; i++) {
+        bool fetched = n_read >= (ssize_t)((i + 1) * SNAPSHOT_LINE_SIZE);
+        slots[i]->address = (uintptr_t)remote_iov[i].iov_base;
+        slots[i]->generation = fetched ? generation : 0;
+    }
+    return n_read == (ssize_t)(missing * SNAPSHOT_LINE_SIZE);
+}
+
+/**
+ * Serves a read from the snapshot, with the same semantics as process_vm_readv.
+ *
+ * @param pid The process to read from.
+ * @param local The buffers receiving the data.
+ * @param local_count The number of elements in `local`.
+ * @param remote The memory ranges to read.
+ * @param remote_count The number of elements in `remote`.
+ * @param[out] n_read The number of bytes read, if served.
+ *
+ * @return True if the read was served, false if it must read the game memory instead.
+ */
+bool snapshot_readv(pid_t pid, const struct iovec* local, unsigned long local_count, const struct iovec* remote, unsigned long remote_count, ssize_t* n_read)
+{
+    if (!active || pid != snapshot_pid || !fetch_lines(remote, remote_count)) {
+        return false;
+    }
+
+    // Copy the remote ranges, one after the other, into the local buffers
+    unsigned long local_index = 0;
+    size_t local_offset = 0;
+    size_t copied = 0;
+    for (unsigned long i = 0; i < remote_count; i++) {
+        uintptr_t address = (uintptr_t)remote[i].iov_base;
+        size_t left = remote[i].iov_len;
+        while (left > 0) {
+            while (local_index < local_count && local_offset == local[local_index].iov_len) {
+                local_index++;
+                local_offset = 0;
+            }
+            if (local_index == local_count) {
+                *n_read = copied;
+                return true;
+            }
+            const SnapshotLine* line = line_slot(address);
+            size_t line_offset = address % SNAPSHOT_LINE_SIZE;
+            size_t size = SNAPSHOT_LINE_SIZE - line_offset;
+            if (size > left) {
+                size = left;
+            }
+            if (size > local[local_index].iov_len - local_offset) {
+                size = local[local_index].iov_len - local_offset;
+            }
+            memcpy((uint8_t*)local[local_index].iov_base + local_offset, line->bytes + line_offset, size);
+            local_offset += size;
+            address += size;
+            left -= size;
+            copied += size;
+        }
+    }
+    *n_read = copied;
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ * The size of a cached line of the game memory, in bytes.
+ *
+ * A divisor of the page size, so a line is always either fully readable or not at all.
+ */
+#define SNAPSHOT_LINE_SIZE 256
+
+/**
+ * The number of cached lines.
+ */
+#define SNAPSHOT_LINES 256
+
+/**
+ * The most lines a single read can be served from, larger reads skip the snapshot.
+ */
+#define SNAPSHOT_MAX_READ_LINES 64
+
+void snapshot_begin(pid_t pid);
+void snapshot_end(void);
+bool snapshot_readv(pid_t pid, const struct iovec* local, unsigned long local_count, const struct iovec* remote, unsigned long remote_count, ssize_t* n_read);
@@ -0,0 +1,342 @@
+/** \file discovery.c
+ *
+ * Finds the game process without spawning any other process.
+ *
+ * Processes are found by reading /proc directly, matching their names with
+ * the same extended regular expressions pgrep used to. While waiting for the game
+ * to start, the kernel proc connector reports every exec and name change, so
+ * only the process that changed has to be checked. The connector needs
+ * CAP_NET_ADMIN, so without it /proc is scanned periodically instead.
+ */
+#include "discovery.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/limits.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * The length of the names in /proc/pid/comm, which are truncated to it.
+ */
+#define DISCOVERY_COMM_LENGTH 15
+
+/**
+ * The name the compiled pattern was compiled from.
+ */
+static char pattern_name[PATH_MAX];
+
+/**
+ * The pattern of the name processes are looked for with.
+ */
+static regex_t pattern;
+
+/**
+ * True if `pattern` holds the compiled pattern of `pattern_name`.
+ */
+static bool pattern_valid = false;
+
+/**
+ * Compiles a name as an extended regular expression, unless it was already.
+ *
+ * @param name The name to look for.
+ *
+ * @return True if the name is a valid regular expression.
+ */
+static bool compile_pattern(const char* name)
+{
+    if (pattern_name[0] && strcmp(pattern_name, name) == 0) {
+        return pattern_valid;
+    }
+    if (pattern_valid) {
+        regfree(&pattern);
+    }
+    snprintf(pattern_name, sizeof(pattern_name), "%s", name);
+    pattern_valid = regcomp(&pattern, name, REG_EXTENDED | REG_NOSUB) == 0;
+    if (!pattern_valid) {
+        printf("[process] %s isn't a valid regular expression, looking for it as plain text\n", name);
+    }
+    return pattern_valid;
+}
+
+/**
+ * Reads a file of /proc/pid.
+ *
+ * @param pid The process.
+ * @param file The file name, like "comm".
+ * @param[out] buffer The buffer receiving the contents, always NUL-terminated.
+ * @param size The size of the buffer.
+ *
+ * @return The number of bytes read, -1 on error.
+ */
+static ssize_t read_proc_file(pid_t pid, const char* file, char* buffer, size_t size)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, file);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    buffer[length > 0 ? length : 0] = '\0';
+    return length;
+}
+
+/**
+ * Gets the file name part of a path, with either separator so Windows paths
+ * of Wine processes work too.
+ */
+static const char* path_basename(const char* path)
+{
+    const char* base = path;
+    for (const char* c = path; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            base = c + 1;
+        }
+    }
+    return base;
+}
+
+/**
+ * Checks if a process matches a process name.
+ *
+ * A process matches if its name (comm) matches the given name as an extended
+ * regular expression, as pgrep would, or starts with it when the name is
+ * longer than what comm can hold. Otherwise the file names of its first
+ * command line argument and of its executable are compared to the given name.
+ *
+ * Names that aren't valid regular expressions are searched as plain text.
+ *
+ * @param pid The process.
+ * @param name The name to look for.
+ *
+ * @return True if the process matches.
+ */
+bool discovery_matches(pid_t pid, const char* name)
+{
+    char buffer[PATH_MAX];
+    if (read_proc_file(pid, "comm", buffer, sizeof(buffer)) <= 0) {
+        return false;
+    }
+    buffer[strcspn(buffer, "\n")] = '\0';
+    bool found = compile_pattern(name) ? regexec(&pattern, buffer, 0, NULL, 0) == 0 : strstr(buffer, name) != NULL;
+    if (found || (strlen(buffer) == DISCOVERY_COMM_LENGTH && strncmp(buffer, name, DISCOVERY_COMM_LENGTH) == 0)) {
+        return true;
+    }
+
+    // The arguments are NUL-separated, so the buffer ends at the first one
+    if (read_proc_file(pid, "cmdline", buffer, sizeof(buffer)) > 0 && strcmp(path_basename(buffer), name) == 0) {
+        return true;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+    ssize_t length = readlink(path, buffer, sizeof(buffer) - 1);
+    if (length > 0) {
+        buffer[length] = '\0';
+        return strcmp(path_basename(buffer), name) == 0;
+    }
+    return false;
+}
+
+/**
+ * Checks if a process has exited but wasn't reaped by its parent yet.
+ *
+ * @param pid The process.
+ *
+ * @return True if the process is a zombie.
+ */
+static bool is_zombie(pid_t pid)
+{
+    char stat[512];
+    if (read_proc_file(pid, "stat", stat, sizeof(stat)) <= 0) {
+        return true;
+    }
+    // The state follows the name, which is in parentheses and may contain anything
+    const char* state = strrchr(stat, ')');
+    return state && (state[2] == 'Z' || state[2] == 'X');
+}
+
+/**
+ * Scans /proc for the processes matching a name.
+ *
+ * @param name The name to look for.
+ * @param pick Which process to return when several match.
+ * @param[out] out_count The number of matching processes, can be NULL.
+ *
+ * @return The PID of the picked process, 0 if none matches.
+ */
+pid_t discovery_scan(const char* name, DiscoveryPick pick, size_t* out_count)
+{
+    size_t count = 0;
+    pid_t picked = 0;
+    pid_t self = getpid();
+
+    DIR* proc = opendir("/proc");
+    if (proc) {
+        struct dirent* entry;
+        while ((entry = readdir(proc)) != NULL) {
+            char* end;
+            long pid = strtol(entry->d_name, &end, 10);
+            if (*end != '\0' || pid <= 0 || pid == self || !discovery_matches(pid, name) || is_zombie(pid)) {
+                continue;
+            }
+            count++;
+            if (!picked || (pick == DISCOVERY_PICK_FIRST ? pid < picked : pid > picked)) {
+                picked = pid;
+            }
+        }
+        closedir(proc);
+    }
+
+    if (out_count) {
+        *out_count = count;
+    }
+    return picked;
+}
+
+/**
+ * Subscribes to the process events of the kernel proc connector.
+ *
+ * @return The netlink socket, -1 if the connector isn't available.
+ */
+static int connector_open(void)
+{
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_nl address = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = CN_IDX_PROC,
+        .nl_pid = 0,
+    };
+    // The request is a netlink header, followed by a connector message holding the operation
+    const size_t payload = sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op);
+    char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] __attribute__((aligned(NLMSG_ALIGNTO))) = { 0 };
+    struct nlmsghdr* header = (struct nlmsghdr*)request;
+    header->nlmsg_len = NLMSG_LENGTH(payload);
+    header->nlmsg_type = NLMSG_DONE;
+    header->nlmsg_pid = getpid();
+    struct cn_msg* message = NLMSG_DATA(header);
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(enum proc_cn_mcast_op);
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    memcpy(message->data, &op, sizeof(op));
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || send(fd, request, header->nlmsg_len, 0) != (ssize_t)header->nlmsg_len) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Waits for process events, checking the processes that exec'd or got renamed.
+ *
+ * @param fd The connector socket.
+ * @param name The name to look for.
+ * @param timeout_ms How long to wait for events.
+ *
+ * @return 1 if a matching process may have appeared, 0 on timeout, -1 if the socket failed.
+ */
+static int connector_wait(int fd, const char* name, int timeout_ms)
+{
+    struct pollfd poll_fd = { .fd = fd, .events = POLLIN };
+    int ready = poll(&poll_fd, 1, timeout_ms);
+    if (ready <= 0) {
+        return ready == 0 || errno == EINTR ? 0 : -1;
+    }
+
+    char buffer[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+    for (;;) {
+        ssize_t length = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return 0;
+            }
+            // Events were dropped, a full scan catches up with them
+            return errno == ENOBUFS ? 1 : -1;
+        }
+
+        for (struct nlmsghdr* header = (struct nlmsghdr*)buffer; NLMSG_OK(header, (size_t)length); header = NLMSG_NEXT(header, length)) {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) {
+                continue;
+            }
+            struct cn_msg* message = NLMSG_DATA(header);
+            struct proc_event* event = (struct proc_event*)message->data;
+            pid_t pid = 0;
+            if (event->what == PROC_EVENT_EXEC) {
+                pid = event->event_data.exec.process_tgid;
+            } else if (event->what == PROC_EVENT_COMM) {
+                // Wine renames its processes after the .exe once started
+                pid = event->event_data.comm.process_tgid;
+            }
+            if (pid > 0 && discovery_matches(pid, name) && !is_zombie(pid)) {
+                return 1;
+            }
+        }
+    }
+}
+
+/**
+ * Waits until a process matching a name is running.
+ *
+ * @param name The name to look for.
+ * @param pick Which process to return when several match.
+ * @param keep_waiting Waiting stops as soon as this becomes false.
+ * @param[out] out_count The number of matching processes, can be NULL.
+ *
+ * @return The PID of the picked process, 0 if waiting was stopped.
+ */
+pid_t discovery_wait(const char* name, DiscoveryPick pick, atomic_bool* keep_waiting, size_t* out_count)
+{
+    // Subscribe before the first scan, so a process starting in between isn't missed
+    int fd = connector_open();
+    pid_t pid = 0;
+    bool rescan = true;
+    bool reported = false;
+
+    while (atomic_load(keep_waiting)) {
+        if (rescan) {
+            pid = discovery_scan(name, pick, out_count);
+            if (pid) {
+                break;
+            }
+            if (!reported) {
+                printf("%s isn't running.\n", name);
+                reported = true;
+            }
+        }
+
+        if (fd < 0) {
+            usleep(DISCOVERY_POLL_INTERVAL_MS * 1000);
+            rescan = true;
+            continue;
+        }
+        int result = connector_wait(fd, name, DISCOVERY_POLL_INTERVAL_MS);
+        if (result < 0) {
+            close(fd);
+            fd = -1;
+        }
+        rescan = result != 0;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    return pid;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * How often /proc is scanned while waiting for a process, when the proc connector isn't available.
+ */
+#define DISCOVERY_POLL_INTERVAL_MS 100
+
+/**
+ * Which process to pick when several match.
+ */
+typedef enum DiscoveryPick {
+    DISCOVERY_PICK_FIRST, /*!< The lowest PID */
+    DISCOVERY_PICK_LAST, /*!< The highest PID */
+} DiscoveryPick;
+
+bool discovery_matches(pid_t pid, const char* name);
+pid_t discovery_scan(const char* name, DiscoveryPick pick, size_t* out_count);
+pid_t discovery_wait(const char* name, DiscoveryPick pick, atomic_bool* keep_waiting, size_t* out_count);
@@ -0,0 +1,86 @@
+/** \file handle.c
+ *
+ * Tracks the lifetime of the game process through a pidfd.
+ *
+ * A pidfd refers to the process itself rather than to its PID, so it can't
+ * be fooled by the PID being reused by another process once the game exits,
+ * and it becomes readable as soon as the process exits, which lets the tick
+ * scheduler wake up on the exit. On kernels without pidfd_open (before
+ * 5.3) the PID is checked with kill() instead.
+ */
+#include "handle.h"
+
+#include "src/lasr/utils.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Opens a pidfd for a process.
+ *
+ * @param pid The process.
+ *
+ * @return The pidfd, -1 if it couldn't be opened.
+ */
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ * Makes a process the game process, opening a pidfd to track it.
+ *
+ * The previous game process is detached first.
+ *
+ * @param pid The process.
+ *
+ * @return False if the process doesn't exist anymore.
+ */
+bool process_attach(pid_t pid)
+{
+    process_detach();
+    process.pid = pid;
+    process.pidfd = open_pidfd(pid);
+    if (process.pidfd < 0 && errno == ESRCH) {
+        process.pid = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Forgets the game process, closing its pidfd.
+ */
+void process_detach(void)
+{
+    if (process.pidfd >= 0) {
+        close(process.pidfd);
+    }
+    process.pidfd = -1;
+    process.pid = 0;
+}
+
+/**
+ * Checks if the game process is still running.
+ *
+ * @return True if the process is running.
+ */
+bool process_isRunning(void)
+{
+    if (process.pid == 0) {
+        return false;
+    }
+    if (process.pidfd < 0) {
+        return kill(process.pid, 0) == 0;
+    }
+    struct pollfd poll_fd = { .fd = process.pidfd, .events = POLLIN };
+    return poll(&poll_fd, 1, 0) == 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+bool process_attach(pid_t pid);
+void process_detach(void);
+bool process_isRunning(void);
@@ -0,0 +1,94 @@
+/** \file image.c
+ *
+ * Inspects the executable image the game is running.
+ *
+ * The headers of the main module stay mapped at its base address, so they are
+ * read from the game memory rather than from the file: this works the same for
+ * native games (ELF) and games running through Wine or Proton (PE).
+ */
+#include "image.h"
+
+#include "src/lasr/memory/read.h"
+#include "src/lasr/utils.h"
+
+#include <string.h>
+
+static const uint8_t elf_magic[] = { 0x7F, 'E', 'L', 'F' };
+
+/**
+ * Offset of the EI_CLASS byte in the ELF identification.
+ */
+#define IMAGE_ELF_CLASS 4
+#define IMAGE_ELF_CLASS_32 1
+#define IMAGE_ELF_CLASS_64 2
+
+/**
+ * Offset of `e_lfanew`, the offset of the PE header, in the DOS header.
+ */
+#define IMAGE_DOS_LFANEW 0x3C
+
+/**
+ * Offset of the optional header magic from the PE signature, after the
+ * signature itself and the 20 bytes of the COFF header.
+ */
+#define IMAGE_PE_MAGIC 24
+#define IMAGE_PE_MAGIC_32 0x10B
+#define IMAGE_PE_MAGIC_64 0x20B
+
+/**
+ * Reads bytes of the game memory.
+ *
+ * @return True if all the bytes were read.
+ */
+static bool read_bytes(uintptr_t address, void* buffer, size_t size)
+{
+    struct iovec local = { .iov_base = buffer, .iov_len = size };
+    struct iovec remote = { .iov_base = (void*)address, .iov_len = size };
+    return memory_readv(process.pid, &local, 1, &remote, 1) == (ssize_t)size;
+}
+
+/**
+ * Finds the size of the pointers of the game from the header of its main module.
+ *
+ * @param base The base address of the main module.
+ *
+ * @return 4 or 8, or 0 if the header isn't a known ELF or PE header.
+ */
+uint8_t image_pointerSize(uintptr_t base)
+{
+    uint8_t header[IMAGE_DOS_LFANEW + sizeof(uint32_t)];
+    if (base == 0 || !read_bytes(base, header, sizeof(header))) {
+        return 0;
+    }
+
+    if (memcmp(header, elf_magic, sizeof(elf_magic)) == 0) {
+        switch (header[IMAGE_ELF_CLASS]) {
+            case IMAGE_ELF_CLASS_32:
+                return 4;
+            case IMAGE_ELF_CLASS_64:
+                return 8;
+            default:
+                return 0;
+        }
+    }
+
+    if (memcmp(header, "MZ", 2) != 0) {
+        return 0;
+    }
+    uint32_t pe_offset;
+    memcpy(&pe_offset, header + IMAGE_DOS_LFANEW, sizeof(pe_offset));
+    uint8_t pe[IMAGE_PE_MAGIC + sizeof(uint16_t)];
+    if (!read_bytes(base + pe_offset, pe, sizeof(pe)) || memcmp(pe, "PE\0\0", 4) != 0) {
+        return 0;
+    }
+    uint16_t magic;
+    memcpy(&magic, pe + IMAGE_PE_MAGIC, sizeof(magic));
+    switch (magic) {
+        case IMAGE_PE_MAGIC_32:
+            return 4;
+        case IMAGE_PE_MAGIC_64:
+            return 8;
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <stdint.h>
+
+uint8_t image_pointerSize(uintptr_t base);
@@ -0,0 +1,285 @@
+/** \file profiler.c
+ *
+ * Per-tick profiler of the auto splitter.
+ *
+ * The auto splitter thread measures every tick and pushes the result into a
+ * single-producer single-consumer ring buffer, without ever blocking. The main
+ * thread drains it and aggregates the ticks into the statistics shown by the
+ * overlay and the dump command. If the main thread falls behind, new ticks are
+ * dropped and counted instead of waiting for room.
+ */
+#include "profiler.h"
+
+#include "../heap/heap.h"
+#include "../memory/read.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+ProfilerStats profiler_stats;
+bool profiler_overlay_visible = false;
+
+/**
+ * The ring buffer between the auto splitter thread and the main thread.
+ *
+ * `head` is only written by the producer and `tail` only by the consumer, both
+ * grow forever and are masked to index `entries`.
+ */
+static struct {
+    ProfilerTick entries[PROFILER_RING_SIZE];
+    atomic_size_t head; /*!< The next entry to be written */
+    atomic_size_t tail; /*!< The next entry to be read */
+    atomic_uint_fast64_t dropped; /*!< The ticks that didn't fit */
+} ring;
+
+static atomic_uint_fast64_t current_session;
+static uint_fast64_t session_dropped; /*!< The dropped ticks counter when the current session was first drained */
+
+/**
+ * Gets the current time, in nanoseconds.
+ */
+static int64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Gets the size of the Lua heap, in bytes.
+ */
+static int64_t heap_size(lua_State* L)
+{
+    return (int64_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+/**
+ * Starts a new script run, so the statistics of the previous one are discarded.
+ *
+ * Called by the auto splitter thread.
+ */
+void profiler_startSession(void)
+{
+    atomic_fetch_add(&current_session, 1);
+}
+
+/**
+ * Starts measuring a tick.
+ *
+ * Called by the auto splitter thread.
+ *
+ * @param tick The measurements of the tick.
+ * @param L The Lua State.
+ */
+void profiler_beginTick(ProfilerTick* tick, lua_State* L)
+{
+    tick->session = atomic_load_explicit(&current_session, memory_order_relaxed);
+    for (size_t i = 0; i < LASR_CALLBACK_COUNT; i++) {
+        tick->callback_ns[i] = -1;
+        tick->callback_reads[i] = 0;
+    }
+    tick->heap_bytes = heap_size(L);
+    tick->tick_started_allocated = heap_stats.allocated;
+    tick->tick_started_reads = atomic_load_explicit(&memory_read_counters.syscalls, memory_order_relaxed);
+    tick->tick_started_bytes = atomic_load_explicit(&memory_read_counters.bytes, memory_order_relaxed);
+    tick->tick_started_ns = now_ns();
+}
+
+/**
+ * Starts measuring a callback.
+ *
+ * @param tick The measurements of the current tick.
+ */
+void profiler_beginCallback(ProfilerTick* tick)
+{
+    tick->callback_started_reads = atomic_load_explicit(&memory_read_counters.syscalls, memory_order_relaxed);
+    tick->callback_started_ns = now_ns();
+}
+
+/**
+ * Stops measuring a callback.
+ *
+ * @param tick The measurements of the current tick.
+ * @param callback The callback that was measured.
+ */
+void profiler_endCallback(ProfilerTick* tick, LasrCallback callback)
+{
+    tick->callback_ns[callback] = now_ns() - tick->callback_started_ns;
+    tick->callback_reads[callback] = atomic_load_explicit(&memory_read_counters.syscalls, memory_order_relaxed) - tick->callback_started_reads;
+}
+
+/**
+ * Stops measuring a tick and hands it over to the main thread.
+ *
+ * @param tick The measurements of the tick.
+ * @param L The Lua State.
+ */
+void profiler_endTick(ProfilerTick* tick, lua_State* L)
+{
+    tick->total_ns = now_ns() - tick->tick_started_ns;
+    tick->reads = atomic_load_explicit(&memory_read_counters.syscalls, memory_order_relaxed) - tick->tick_started_reads;
+    tick->bytes_read = atomic_load_explicit(&memory_read_counters.bytes, memory_order_relaxed) - tick->tick_started_bytes;
+    int64_t heap = heap_size(L);
+    tick->heap_growth = heap - tick->heap_bytes;
+    tick->heap_bytes = heap;
+    tick->heap_allocated = heap_stats.allocated - tick->tick_started_allocated;
+
+    size_t head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring.tail, memory_order_acquire);
+    if (head - tail == PROFILER_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ring.entries[head & (PROFILER_RING_SIZE - 1)] = *tick;
+    atomic_store_explicit(&ring.head, head + 1, memory_order_release);
+}
+
+/**
+ * Adds a measured time to aggregated timings.
+ */
+static void record_timing(ProfilerTimings* timings, int64_t ns, uint32_t reads)
+{
+    timings->calls++;
+    timings->total_ns += ns;
+    timings->last_ns = ns;
+    timings->reads += reads;
+    if (ns > timings->max_ns) {
+        timings->max_ns = ns;
+    }
+    size_t bucket = 0;
+    for (int64_t us = ns / 1000; us > 0 && bucket < PROFILER_BUCKETS - 1; us >>= 1) {
+        bucket++;
+    }
+    timings->histogram[bucket]++;
+}
+
+/**
+ * Aggregates the ticks measured since the last call into `profiler_stats`.
+ *
+ * Must always be called from the same thread.
+ *
+ * @return True if new ticks were aggregated.
+ */
+bool profiler_drain(void)
+{
+    size_t tail = atomic_load_explicit(&ring.tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring.head, memory_order_acquire);
+    if (tail == head) {
+        return false;
+    }
+
+    for (; tail != head; tail++) {
+        const ProfilerTick* tick = &ring.entries[tail & (PROFILER_RING_SIZE - 1)];
+        ProfilerStats* stats = &profiler_stats;
+        if (tick->session != stats->session) {
+            memset(stats, 0, sizeof(*stats));
+            stats->session = tick->session;
+            session_dropped = atomic_load_explicit(&ring.dropped, memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < LASR_CALLBACK_COUNT; i++) {
+            if (tick->callback_ns[i] >= 0) {
+                record_timing(&stats->callbacks[i], tick->callback_ns[i], tick->callback_reads[i]);
+            }
+        }
+        record_timing(&stats->ticks, tick->total_ns, tick->reads);
+        stats->bytes_read += tick->bytes_read;
+        if (tick->reads > stats->max_reads) {
+            stats->max_reads = tick->reads;
+        }
+        if (tick->bytes_read > stats->max_bytes_read) {
+            stats->max_bytes_read = tick->bytes_read;
+        }
+        stats->heap_bytes = tick->heap_bytes;
+        if (tick->heap_growth > stats->max_heap_growth) {
+            stats->max_heap_growth = tick->heap_growth;
+        }
+        if (tick->heap_growth > 0) {
+            stats->heap_allocated += tick->heap_growth;
+        }
+        stats->allocated += tick->heap_allocated;
+        if (tick->heap_allocated > stats->max_allocated) {
+            stats->max_allocated = tick->heap_allocated;
+        }
+    }
+    atomic_store_explicit(&ring.tail, tail, memory_order_release);
+    profiler_stats.dropped = atomic_load_explicit(&ring.dropped, memory_order_relaxed) - session_dropped;
+    return true;
+}
+
+/**
+ * Estimates a percentile of aggregated timings from their histogram.
+ *
+ * @param timings The timings.
+ * @param fraction The percentile, between 0 and 1.
+ *
+ * @return The upper bound of the histogram bucket holding the percentile, in
+ * nanoseconds, or the maximum time if it lies in the last bucket.
+ */
+int64_t profiler_percentile(const ProfilerTimings* timings, double fraction)
+{
+    uint64_t wanted = (uint64_t)(fraction * timings->calls + 0.5);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < PROFILER_BUCKETS - 1; i++) {
+        seen += timings->histogram[i];
+        if (seen >= wanted && seen > 0) {
+            int64_t bound = (int64_t)1000 << i;
+            return bound < timings->max_ns ? bound : timings->max_ns;
+        }
+    }
+    return timings->max_ns;
+}
+
+/**
+ * Prints a line of the timing table.
+ */
+static void dump_timings(FILE* out, const char* name, const ProfilerTimings* timings)
+{
+    if (!timings->calls) {
+        return;
+    }
+    fprintf(out, "%-10s %10" PRIu64 " %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+        name,
+        timings->calls,
+        timings->total_ns / 1000.0 / timings->calls,
+        profiler_percentile(timings, 0.5) / 1000.0,
+        profiler_percentile(timings, 0.99) / 1000.0,
+        timings->max_ns / 1000.0,
+        (double)timings->reads / timings->calls);
+}
+
+/**
+ * Prints the statistics of the current script run.
+ *
+ * Must be called from the thread calling profiler_drain.
+ *
+ * @param out Where to print the statistics.
+ */
+void profiler_dump(FILE* out)
+{
+    profiler_drain();
+    const ProfilerStats* stats = &profiler_stats;
+    if (!stats->ticks.calls) {
+        fprintf(out, "No auto splitter ticks were profiled yet.\n");
+        return;
+    }
+
+    fprintf(out, "%-10s %10s %10s %10s %10s %10s %10s\n", "callback", "calls", "avg us", "p50 us", "p99 us", "max us", "reads");
+    for (size_t i = 0; i < LASR_CALLBACK_COUNT; i++) {
+        dump_timings(out, lasr_callback_names[i], &stats->callbacks[i]);
+    }
+    dump_timings(out, "tick", &stats->ticks);
+
+    fprintf(out, "Bytes read: %.1f per tick, at most %" PRIu64 "\n", (double)stats->bytes_read / stats->ticks.calls, stats->max_bytes_read);
+    fprintf(out, "Reads: at most %" PRIu32 " per tick\n", stats->max_reads);
+    fprintf(out, "Lua heap: %.1fKB, growing by %.1f bytes per tick on average, at most %" PRId64 "\n",
+        stats->heap_bytes / 1024.0, (double)stats->heap_allocated / stats->ticks.calls, stats->max_heap_growth);
+    if (heap_stats.active) {
+        fprintf(out, "Lua allocations: %.1f bytes per tick on average, at most %" PRIu64 "\n",
+            (double)stats->allocated / stats->ticks.calls, stats->max_allocated);
+    }
+    if (stats->dropped) {
+        fprintf(out, "Ticks dropped: %" PRIu64 "\n", stats->dropped);
+    }
+}
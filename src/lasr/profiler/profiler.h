@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../dispatch/dispatch.h"
+
+#include <lua.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The number of ticks the ring buffer holds until the main thread drains it.
+ *
+ * Must be a power of two.
+ */
+#define PROFILER_RING_SIZE 256
+
+/**
+ * The number of buckets of the timing histograms.
+ *
+ * Bucket `i` counts the calls that took less than 2^i microseconds, the last
+ * one counts all the longer calls.
+ */
+#define PROFILER_BUCKETS 20
+
+/**
+ * The measurements of a single tick, recorded by the auto splitter thread.
+ */
+typedef struct ProfilerTick {
+    uint64_t session; /*!< Identifies the script run the tick belongs to */
+    int64_t callback_ns[LASR_CALLBACK_COUNT]; /*!< The wall time of each callback, -1 if it wasn't called */
+    uint32_t callback_reads[LASR_CALLBACK_COUNT]; /*!< The process_vm_readv calls made by each callback */
+    int64_t total_ns; /*!< The wall time of the whole tick, without the wait for the next one */
+    uint32_t reads; /*!< The process_vm_readv calls made during the tick */
+    uint64_t bytes_read; /*!< The bytes read from the game during the tick */
+    int64_t heap_growth; /*!< How much the Lua heap grew during the tick, negative if the GC freed more than was allocated */
+    int64_t heap_bytes; /*!< The size of the Lua heap at the end of the tick */
+    uint64_t heap_allocated; /*!< The bytes Lua allocated during the tick, freed or not */
+
+    // Bookkeeping of the measurement in progress
+    int64_t tick_started_ns; /*!< When the tick started */
+    int64_t callback_started_ns; /*!< When the callback being measured started */
+    uint_fast64_t tick_started_reads; /*!< The read counter when the tick started */
+    uint_fast64_t tick_started_bytes; /*!< The byte counter when the tick started */
+    uint64_t tick_started_allocated; /*!< The allocated bytes counter of the heap when the tick started */
+    uint_fast64_t callback_started_reads; /*!< The read counter when the callback being measured started */
+} ProfilerTick;
+
+/**
+ * Aggregated timings of a callback, or of whole ticks.
+ */
+typedef struct ProfilerTimings {
+    uint64_t calls; /*!< The number of measured calls */
+    int64_t total_ns; /*!< The sum of the measured times */
+    int64_t max_ns; /*!< The longest measured time */
+    int64_t last_ns; /*!< The latest measured time */
+    uint64_t reads; /*!< The process_vm_readv calls made by all the calls */
+    uint64_t histogram[PROFILER_BUCKETS]; /*!< Histogram of the measured times */
+} ProfilerTimings;
+
+/**
+ * Statistics of the current script run, aggregated on the main thread.
+ */
+typedef struct ProfilerStats {
+    uint64_t session; /*!< The script run the statistics are about */
+    uint64_t dropped; /*!< Ticks lost because the ring buffer was full */
+    ProfilerTimings callbacks[LASR_CALLBACK_COUNT]; /*!< The timings of each callback */
+    ProfilerTimings ticks; /*!< The timings of whole ticks */
+    uint64_t bytes_read; /*!< The bytes read from the game */
+    uint32_t max_reads; /*!< The most process_vm_readv calls made in a tick */
+    uint64_t max_bytes_read; /*!< The most bytes read in a tick */
+    int64_t heap_bytes; /*!< The size of the Lua heap after the latest tick */
+    int64_t max_heap_growth; /*!< The most the Lua heap grew in a tick */
+    uint64_t heap_allocated; /*!< The sum of the heap growths of all the ticks */
+    uint64_t allocated; /*!< The bytes Lua allocated during all the ticks */
+    uint64_t max_allocated; /*!< The most bytes Lua allocated in a tick */
+} ProfilerStats;
+
+extern ProfilerStats profiler_stats;
+extern bool profiler_overlay_visible;
+
+void profiler_startSession(void);
+void profiler_beginTick(ProfilerTick* tick, lua_State* L);
+void profiler_beginCallback(ProfilerTick* tick);
+void profiler_endCallback(ProfilerTick* tick, LasrCallback callback);
+void profiler_endTick(ProfilerTick* tick, lua_State* L);
+bool profiler_drain(void);
+int64_t profiler_percentile(const ProfilerTimings* timings, double fraction);
+void profiler_dump(FILE* out);
@@ -0,0 +1,93 @@
+/** \file reload.c
+ *
+ * Detects changes of the auto splitter file, so it can be reloaded while the
+ * auto splitter runs.
+ *
+ * The directory of the file is watched with inotify rather than the file
+ * itself, since most editors save by writing a new file and renaming it over
+ * the old one, which would end a watch on the file. The watch is polled once
+ * per tick and never blocks.
+ */
+#include "reload.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static int inotify_fd = -1;
+static char watched_name[NAME_MAX + 1]; /*!< The name of the watched file in its directory */
+
+/**
+ * Starts watching a file for changes, replacing the previous watch.
+ *
+ * @param path The path of the file.
+ *
+ * @return False if the file can't be watched, changes then go unnoticed.
+ */
+bool reload_watch(const char* path)
+{
+    reload_stop();
+
+    char directory[PATH_MAX];
+    const char* slash = strrchr(path, '/');
+    if (!slash) {
+        strcpy(directory, ".");
+        snprintf(watched_name, sizeof(watched_name), "%s", path);
+    } else {
+        size_t length = slash == path ? 1 : (size_t)(slash - path);
+        snprintf(directory, sizeof(directory), "%.*s", (int)length, path);
+        snprintf(watched_name, sizeof(watched_name), "%s", slash + 1);
+    }
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 || inotify_add_watch(inotify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        printf("[reload] Can't watch %s for changes: %s\n", path, strerror(errno));
+        reload_stop();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks if the watched file was saved since the last call.
+ *
+ * All the pending changes are consumed, so saving several times between two
+ * calls only reloads the file once.
+ *
+ * @return True if the file changed.
+ */
+bool reload_changed(void)
+{
+    if (inotify_fd < 0) {
+        return false;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    ssize_t length;
+    while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* position = buffer; position < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)position;
+            if (event->len && strcmp(event->name, watched_name) == 0) {
+                changed = true;
+            }
+            position += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Stops watching the file.
+ */
+void reload_stop(void)
+{
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+    inotify_fd = -1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdbool.h>
+
+bool reload_watch(const char* path);
+bool reload_changed(void);
+void reload_stop(void);
@@ -0,0 +1,229 @@
+/** \file cache.c
+ *
+ * Persistent cache of signature scan results.
+ *
+ * Matches found inside a module backed by a file are stored in the LibreSplit
+ * config folder as an offset from the start of the module, along with the
+ * size and modification time of the file. As long as the game binary doesn't
+ * change, the next scans of the same signature only need to read the few
+ * bytes at the cached address to confirm the match.
+ *
+ * The file is a JSON object, with one object per process name mapping the
+ * scan keys (see scan_cacheKey) to their cached result:
+ * `{"module": path, "size": bytes, "mtime": seconds, "offset": offset}`.
+ *
+ * New results are only written to the file by scan_cacheSave, once per scan.
+ */
+#include "cache.h"
+
+#include "src/lasr/memory/arena.h"
+#include "src/lasr/memory/read.h"
+#include "src/lasr/utils.h"
+#include "src/settings/utils.h"
+
+#include <inttypes.h>
+#include <jansson.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static json_t* cache_root = NULL;
+static bool cache_dirty = false; /*!< True if results were stored since the file was written */
+
+/**
+ * Gets the path of the cache file.
+ *
+ * @param[out] path The path, PATH_MAX bytes long.
+ *
+ * @return False if the path is too long.
+ */
+static bool cache_path(char* path)
+{
+    get_libresplit_folder_path(path);
+    size_t length = strlen(path);
+    int written = snprintf(path + length, PATH_MAX - length, "/%s", SCAN_CACHE_FILE);
+    return written >= 0 && (size_t)written < PATH_MAX - length;
+}
+
+/**
+ * Gets the cached results of the current process, loading the cache file
+ * the first time.
+ *
+ * @param create Whether to create the object of the process if it doesn't exist.
+ *
+ * @return The object mapping keys to results, NULL if there is none.
+ */
+static json_t* cache_process(bool create)
+{
+    if (!cache_root) {
+        char path[PATH_MAX] = { 0 };
+        json_error_t error;
+        cache_root = cache_path(path) ? json_load_file(path, 0, &error) : NULL;
+        if (!cache_root || !json_is_object(cache_root)) {
+            // Missing or invalid, start over
+            json_decref(cache_root);
+            cache_root = json_object();
+        }
+    }
+    if (!cache_root || !process.name) {
+        return NULL;
+    }
+
+    json_t* results = json_object_get(cache_root, process.name);
+    if (!json_is_object(results)) {
+        if (!create) {
+            return NULL;
+        }
+        results = json_object();
+        json_object_set_new(cache_root, process.name, results);
+    }
+    return results;
+}
+
+/**
+ * Builds the key under which the result of a scan is cached.
+ *
+ * The options that change the result are part of the key, so the same
+ * signature scanned in different regions is cached separately.
+ *
+ * @param signature The signature.
+ * @param filter The filter of the scanned regions.
+ *
+ * @return The key, allocated from the LASR arena, or NULL if the allocation failed.
+ */
+char* scan_cacheKey(const char* signature, const MapsFilter* filter)
+{
+    char options[PATH_MAX + 128];
+    int length = snprintf(options, sizeof(options), "|%s|%s|%" PRIxPTR "|%" PRIxPTR "|%" PRIxPTR,
+        filter->module ? filter->module : "",
+        filter->perms ? filter->perms : "",
+        filter->min_address,
+        filter->max_address,
+        filter->max_size);
+    if (length < 0) {
+        return NULL;
+    }
+
+    size_t signature_length = strlen(signature);
+    char* key = arena_alloc(signature_length + length + 1);
+    if (key) {
+        memcpy(key, signature, signature_length);
+        strcpy(key + signature_length, options);
+    }
+    return key;
+}
+
+/**
+ * Looks up a signature in the cache, checking that the cached address still
+ * matches the pattern.
+ *
+ * @param key The key of the scan.
+ * @param pattern The compiled signature.
+ * @param[out] match The address of the match.
+ *
+ * @return True if the cached result is still valid.
+ */
+bool scan_cacheLookup(const char* key, const ScanPattern* pattern, uintptr_t* match)
+{
+    json_t* entry = json_object_get(cache_process(false), key);
+    if (!json_is_object(entry)) {
+        return false;
+    }
+    const char* module = json_string_value(json_object_get(entry, "module"));
+    json_t* offset = json_object_get(entry, "offset");
+    if (!module || !json_is_integer(offset)) {
+        return false;
+    }
+
+    struct stat st;
+    if (stat(module, &st) != 0
+        || st.st_size != json_integer_value(json_object_get(entry, "size"))
+        || st.st_mtime != json_integer_value(json_object_get(entry, "mtime"))) {
+        return false;
+    }
+
+    uintptr_t base;
+    if (!maps_findModuleBase(module, &base)) {
+        return false;
+    }
+    uintptr_t address = base + json_integer_value(offset);
+
+    ArenaMark mark = arena_mark();
+    uint8_t* bytes = arena_alloc(pattern->length);
+    if (!bytes) {
+        arena_release(mark);
+        return false;
+    }
+    struct iovec local = { .iov_base = bytes, .iov_len = pattern->length };
+    struct iovec remote = { .iov_base = (void*)address, .iov_len = pattern->length };
+    ssize_t read = memory_readv(process.pid, &local, 1, &remote, 1);
+    bool valid = read == (ssize_t)pattern->length && scan_matchAt(pattern, bytes);
+    arena_release(mark);
+
+    if (valid) {
+        *match = address;
+    }
+    return valid;
+}
+
+/**
+ * Stores the result of a scan in the cache, to be written by scan_cacheSave.
+ *
+ * Matches outside of a module backed by a file, like on the heap, are not
+ * cached since their address changes every time.
+ *
+ * @param key The key of the scan.
+ * @param match The address of the match.
+ */
+void scan_cacheStore(const char* key, uintptr_t match)
+{
+    ProcessMap module;
+    struct stat st;
+    if (!maps_findModuleOf(match, &module) || stat(module.name, &st) != 0) {
+        return;
+    }
+    json_t* results = cache_process(true);
+    if (!results) {
+        return;
+    }
+
+    json_t* entry = json_object();
+    json_object_set_new(entry, "module", json_string(module.name));
+    json_object_set_new(entry, "size", json_integer(st.st_size));
+    json_object_set_new(entry, "mtime", json_integer(st.st_mtime));
+    json_object_set_new(entry, "offset", json_integer(match - module.start));
+    json_object_set_new(results, key, entry);
+    cache_dirty = true;
+}
+
+/**
+ * Writes the cache file, if results were stored since it was last written.
+ */
+void scan_cacheSave(void)
+{
+    if (!cache_dirty) {
+        return;
+    }
+    cache_dirty = false;
+
+    char path[PATH_MAX] = { 0 };
+    if (!cache_path(path)) {
+        printf("[sig_scan] The path of the signature cache is too long\n");
+        return;
+    }
+    if (json_dump_file(cache_root, path, JSON_INDENT(2) | JSON_PRESERVE_ORDER) != 0) {
+        printf("[sig_scan] Failed to save the signature cache to %s\n", path);
+    }
+}
+
+/**
+ * Writes the pending results and frees the cache, which is loaded again from
+ * the file by the next lookup.
+ */
+void scan_cacheClose(void)
+{
+    scan_cacheSave();
+    json_decref(cache_root);
+    cache_root = NULL;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "pattern.h"
+#include "src/lasr/maps/maps.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The name of the cache file, in the LibreSplit config folder.
+ */
+#define SCAN_CACHE_FILE "sig-cache.json"
+
+char* scan_cacheKey(const char* signature, const MapsFilter* filter);
+bool scan_cacheLookup(const char* key, const ScanPattern* pattern, uintptr_t* match);
+void scan_cacheStore(const char* key, uintptr_t match);
+void scan_cacheSave(void);
+void scan_cacheClose(void);
@@ -0,0 +1,199 @@
+/** \file multi.c
+ *
+ * Multi-pattern matching, to look for many signatures in a single pass.
+ *
+ * A handful of patterns are simply searched one after the other on the same
+ * chunk, which is still hot in the cache. With more patterns, every byte of
+ * the chunk is looked up in a table indexed by the first anchor byte of each
+ * pattern, so the data is walked only once regardless of the pattern count.
+ */
+#include "multi.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/**
+ * Prefilter candidates with vector compares when there are at most this many distinct anchor bytes.
+ */
+#define SCAN_MULTI_VECTOR_ANCHORS 16
+
+/**
+ * Compiles a set of patterns into a multi-pattern matcher.
+ *
+ * @param patterns The compiled patterns, which must outlive the matcher.
+ * @param count The number of patterns.
+ * @param[out] out The matcher, to be freed with scan_freeMulti.
+ *
+ * @return True on success, false if the allocation failed.
+ */
+bool scan_compileMulti(const ScanPattern* patterns, size_t count, ScanMultiPattern* out)
+{
+    memset(out, 0, sizeof(*out));
+    out->patterns = patterns;
+    out->count = count;
+
+    size_t per_byte[256] = { 0 };
+    for (size_t i = 0; i < count; i++) {
+        if (patterns[i].length > out->max_length) {
+            out->max_length = patterns[i].length;
+        }
+        if (patterns[i].has_anchor) {
+            per_byte[patterns[i].bytes[patterns[i].anchor]]++;
+        } else {
+            out->wildcards_count++;
+        }
+    }
+
+    for (int byte = 0; byte < 256; byte++) {
+        out->dispatch_start[byte + 1] = out->dispatch_start[byte] + per_byte[byte];
+        if (per_byte[byte]) {
+            if (out->anchor_bytes_count < sizeof(out->anchor_bytes)) {
+                out->anchor_bytes[out->anchor_bytes_count] = byte;
+            }
+            out->anchor_bytes_count++;
+        }
+    }
+
+    out->dispatch = malloc((count ? count : 1) * sizeof(size_t));
+    if (!out->dispatch) {
+        return false;
+    }
+    size_t cursor[256];
+    memcpy(cursor, out->dispatch_start, sizeof(cursor));
+    for (size_t i = 0; i < count; i++) {
+        if (patterns[i].has_anchor) {
+            out->dispatch[cursor[patterns[i].bytes[patterns[i].anchor]]++] = i;
+        }
+    }
+    return true;
+}
+
+/**
+ * Frees the memory used by a multi-pattern matcher.
+ *
+ * The patterns themselves are not freed.
+ *
+ * @param multi The matcher to free.
+ */
+void scan_freeMulti(ScanMultiPattern* multi)
+{
+    free(multi->dispatch);
+    multi->dispatch = NULL;
+}
+
+/**
+ * Verifies all the wanted patterns anchored on the byte at a position.
+ *
+ * @param multi The matcher.
+ * @param data The data being searched.
+ * @param size The size of the data.
+ * @param position The position of the anchor candidate.
+ * @param wanted Which patterns are still being searched.
+ * @param offsets The matches found so far.
+ * @param remaining The number of wanted patterns not found yet, updated on matches.
+ */
+static void verify_candidates(const ScanMultiPattern* multi, const uint8_t* data, size_t size, size_t position, const bool* wanted, size_t* offsets, size_t* remaining)
+{
+    const uint8_t byte = data[position];
+    for (size_t k = multi->dispatch_start[byte]; k < multi->dispatch_start[byte + 1]; k++) {
+        size_t p = multi->dispatch[k];
+        const ScanPattern* pattern = &multi->patterns[p];
+        if (!wanted[p] || offsets[p] != SCAN_NOT_FOUND || position < pattern->anchor) {
+            continue;
+        }
+        size_t start = position - pattern->anchor;
+        if (start + pattern->length <= size && scan_matchAt(pattern, data + start)) {
+            offsets[p] = start;
+            (*remaining)--;
+        }
+    }
+}
+
+#ifdef SCAN_X86
+/**
+ * Walks the data 16 bytes at a time, only looking up the positions that
+ * hold one of the few anchor bytes.
+ *
+ * @return The position the vector loop stopped at.
+ */
+__attribute__((target("sse2"))) static size_t dispatch_sse2(const ScanMultiPattern* multi, const uint8_t* data, size_t size, const bool* wanted, size_t* offsets, size_t* remaining)
+{
+    __m128i anchors[SCAN_MULTI_VECTOR_ANCHORS];
+    for (size_t a = 0; a < multi->anchor_bytes_count; a++) {
+        anchors[a] = _mm_set1_epi8((char)multi->anchor_bytes[a]);
+    }
+
+    size_t i = 0;
+    for (; i + 16 <= size && *remaining; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i hits = _mm_setzero_si128();
+        for (size_t a = 0; a < multi->anchor_bytes_count; a++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, anchors[a]));
+        }
+        unsigned int candidates = _mm_movemask_epi8(hits);
+        while (candidates && *remaining) {
+            verify_candidates(multi, data, size, i + __builtin_ctz(candidates), wanted, offsets, remaining);
+            candidates &= candidates - 1;
+        }
+    }
+    return i;
+}
+#endif
+
+/**
+ * Finds the first match of every wanted pattern in a block of data.
+ *
+ * @param multi The matcher.
+ * @param data The data to search in.
+ * @param size The size of the data.
+ * @param wanted For each pattern, whether it has to be searched.
+ * @param[out] offsets For each pattern, the offset of its first match, or SCAN_NOT_FOUND.
+ *
+ * @return The number of patterns found.
+ */
+size_t scan_findMany(const ScanMultiPattern* multi, const uint8_t* data, size_t size, const bool* wanted, size_t* offsets)
+{
+    size_t remaining = 0;
+    for (size_t p = 0; p < multi->count; p++) {
+        offsets[p] = SCAN_NOT_FOUND;
+        remaining += wanted[p];
+    }
+    const size_t total = remaining;
+
+    if (remaining <= SCAN_MULTI_DIRECT) {
+        for (size_t p = 0; p < multi->count; p++) {
+            if (wanted[p]) {
+                offsets[p] = scan_find(&multi->patterns[p], data, size);
+                remaining -= offsets[p] != SCAN_NOT_FOUND;
+            }
+        }
+        return total - remaining;
+    }
+
+    if (multi->wildcards_count) {
+        for (size_t p = 0; p < multi->count; p++) {
+            if (wanted[p] && !multi->patterns[p].has_anchor && multi->patterns[p].length <= size) {
+                offsets[p] = 0;
+                remaining--;
+            }
+        }
+    }
+
+    size_t i = 0;
+#ifdef SCAN_X86
+    if (multi->anchor_bytes_count <= SCAN_MULTI_VECTOR_ANCHORS) {
+        i = dispatch_sse2(multi, data, size, wanted, offsets, &remaining);
+    }
+#endif
+    for (; i < size && remaining; i++) {
+        if (multi->dispatch_start[data[i]] != multi->dispatch_start[data[i] + 1]) {
+            verify_candidates(multi, data, size, i, wanted, offsets, &remaining);
+        }
+    }
+    return total - remaining;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "pattern.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Up to this many patterns are searched one by one with scan_find,
+ * more than that go through the anchor dispatch table.
+ */
+#define SCAN_MULTI_DIRECT 4
+
+/**
+ * A set of patterns searched in a single pass.
+ *
+ * Patterns are indexed by the byte value of their first anchor: every byte
+ * of the data is looked up in the dispatch table, and only the patterns
+ * anchored on that byte are verified.
+ */
+typedef struct ScanMultiPattern {
+    const ScanPattern* patterns; /*!< The patterns to look for */
+    size_t count; /*!< The number of patterns */
+    size_t max_length; /*!< The length of the longest pattern */
+    size_t dispatch_start[257]; /*!< For each byte value, where its patterns start in `dispatch` */
+    size_t* dispatch; /*!< Pattern indexes, grouped by anchor byte value */
+    uint8_t anchor_bytes[16]; /*!< The distinct anchor byte values, if there are few of them */
+    size_t anchor_bytes_count; /*!< The number of distinct anchor byte values */
+    size_t wildcards_count; /*!< The number of patterns made only of wildcards */
+} ScanMultiPattern;
+
+bool scan_compileMulti(const ScanPattern* patterns, size_t count, ScanMultiPattern* out);
+void scan_freeMulti(ScanMultiPattern* multi);
+size_t scan_findMany(const ScanMultiPattern* multi, const uint8_t* data, size_t size, const bool* wanted, size_t* offsets);
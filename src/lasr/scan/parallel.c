@@ -0,0 +1,277 @@
+/** \file parallel.c
+ *
+ * Multi-threaded signature scanning.
+ *
+ * The regions to scan are split into work items, sorted by address, which
+ * are picked up by a pool of threads. Every item remembers its own first
+ * match of each pattern, and for each pattern the lowest item with a match
+ * wins, so the result is always the same as the one of a serial scan. Items
+ * after the best match of every pattern are skipped, since they can't
+ * contain a lower match.
+ */
+#include "parallel.h"
+
+#include "reader.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * A slice of a memory region, scanned by a single thread.
+ */
+typedef struct ScanWorkItem {
+    uintptr_t start; /*!< The start address of the slice */
+    uintptr_t end; /*!< The end address of the slice, including the overlap with the next one */
+} ScanWorkItem;
+
+/**
+ * The state of a parallel scan, shared by all the threads.
+ */
+typedef struct ScanJob {
+    pid_t pid; /*!< The process to scan */
+    const ScanMultiPattern* multi; /*!< The patterns to look for */
+    ScanWorkItem* items; /*!< The work items, sorted by address */
+    size_t items_count; /*!< The number of work items */
+    uintptr_t* matches; /*!< The first match of each pattern in each item, `items_count * multi->count` entries */
+    atomic_size_t next_item; /*!< The next item to be picked up */
+    atomic_size_t* best_items; /*!< For each pattern, the lowest item with a match, SIZE_MAX if none */
+} ScanJob;
+
+/**
+ * The state of a thread scanning a single work item.
+ */
+typedef struct ScanItemContext {
+    ScanJob* job; /*!< The job the item belongs to */
+    size_t item; /*!< The index of the item being scanned */
+    bool* wanted; /*!< For each pattern, whether it is still searched in the item */
+    size_t* offsets; /*!< Scratch space for the matches in a chunk */
+} ScanItemContext;
+
+/**
+ * Lowers the best item of a pattern, if the new item comes earlier.
+ *
+ * @param job The job.
+ * @param pattern The index of the pattern.
+ * @param item The item that contains a match.
+ */
+static void lower_best_item(ScanJob* job, size_t pattern, size_t item)
+{
+    size_t best = atomic_load(&job->best_items[pattern]);
+    while (item < best && !atomic_compare_exchange_weak(&job->best_items[pattern], &best, item)) {
+    }
+}
+
+/**
+ * Updates which patterns can still improve the result from a given item.
+ *
+ * @param job The job.
+ * @param item The item.
+ * @param[out] wanted For each pattern, whether it has no match before the item yet.
+ *
+ * @return The number of wanted patterns.
+ */
+static size_t update_wanted(ScanJob* job, size_t item, bool* wanted)
+{
+    size_t count = 0;
+    for (size_t p = 0; p < job->multi->count; p++) {
+        wanted[p] = atomic_load(&job->best_items[p]) > item;
+        count += wanted[p];
+    }
+    return count;
+}
+
+/**
+ * Looks for the patterns in a chunk of memory of a work item.
+ *
+ * @param userdata The ScanItemContext of the item.
+ * @param data The bytes read.
+ * @param size The number of bytes read.
+ * @param address The address the bytes were read from.
+ *
+ * @return True if no pattern can be improved by the item anymore, stopping its scan.
+ */
+static bool find_in_chunk(void* userdata, const uint8_t* data, size_t size, uintptr_t address)
+{
+    ScanItemContext* context = userdata;
+    ScanJob* job = context->job;
+    if (update_wanted(job, context->item, context->wanted) == 0) {
+        return true;
+    }
+
+    if (scan_findMany(job->multi, data, size, context->wanted, context->offsets) == 0) {
+        return false;
+    }
+    for (size_t p = 0; p < job->multi->count; p++) {
+        if (context->offsets[p] != SCAN_NOT_FOUND) {
+            job->matches[context->item * job->multi->count + p] = address + context->offsets[p];
+            lower_best_item(job, p, context->item);
+        }
+    }
+    return update_wanted(job, context->item, context->wanted) == 0;
+}
+
+/**
+ * Picks up and scans work items until there are none left that could
+ * improve the result.
+ *
+ * @param arg The ScanJob.
+ *
+ * @return Always NULL.
+ */
+static void* scan_worker(void* arg)
+{
+    ScanJob* job = arg;
+    ScanReader reader;
+    if (!scan_initReader(&reader, job->pid, job->multi->max_length - 1)) {
+        return NULL;
+    }
+    ScanItemContext context = {
+        .job = job,
+        .wanted = malloc(job->multi->count * sizeof(bool)),
+        .offsets = malloc(job->multi->count * sizeof(size_t)),
+    };
+
+    while (context.wanted && context.offsets) {
+        size_t item = atomic_fetch_add(&job->next_item, 1);
+        if (item >= job->items_count || update_wanted(job, item, context.wanted) == 0) {
+            break;
+        }
+        context.item = item;
+        scan_readRegion(&reader, job->items[item].start, job->items[item].end, find_in_chunk, &context);
+    }
+
+    free(context.wanted);
+    free(context.offsets);
+    scan_freeReader(&reader);
+    return NULL;
+}
+
+/**
+ * Splits the regions into work items of at most SCAN_SLICE_SIZE bytes.
+ *
+ * Slices overlap by `pattern_length - 1` bytes, so that every match
+ * starting inside a slice can be found entirely in it. Regions that aren't
+ * readable are left out: the reader would fault on each of their pages.
+ *
+ * @param regions The regions to split, sorted by address.
+ * @param regions_count The number of regions.
+ * @param pattern_length The length of the longest pattern.
+ * @param[out] items_count The number of items created.
+ * @param[out] total_size The total amount of bytes to scan.
+ *
+ * @return The work items, NULL if the allocation failed.
+ */
+static ScanWorkItem* split_regions(const ProcessMap* regions, size_t regions_count, size_t pattern_length, size_t* items_count, size_t* total_size)
+{
+    size_t count = 0;
+    *total_size = 0;
+    for (size_t i = 0; i < regions_count; i++) {
+        if (regions[i].perms[0] != 'r') {
+            continue;
+        }
+        size_t size = regions[i].end - regions[i].start;
+        count += (size + SCAN_SLICE_SIZE - 1) / SCAN_SLICE_SIZE;
+        *total_size += size;
+    }
+
+    ScanWorkItem* items = malloc((count ? count : 1) * sizeof(ScanWorkItem));
+    if (!items) {
+        return NULL;
+    }
+
+    size_t item = 0;
+    for (size_t i = 0; i < regions_count; i++) {
+        if (regions[i].perms[0] != 'r') {
+            continue;
+        }
+        for (uintptr_t start = regions[i].start; start < regions[i].end; start += SCAN_SLICE_SIZE) {
+            uintptr_t end = start + SCAN_SLICE_SIZE + pattern_length - 1;
+            items[item].start = start;
+            items[item].end = end < regions[i].end && end > start ? end : regions[i].end;
+            item++;
+        }
+    }
+    *items_count = item;
+    return items;
+}
+
+/**
+ * Finds the lowest address matching each pattern in a set of memory regions,
+ * spreading the work across all the available cores.
+ *
+ * The memory is read only once, whatever the number of patterns.
+ *
+ * @param pid The process to scan.
+ * @param regions The regions to scan, sorted by address.
+ * @param regions_count The number of regions.
+ * @param multi The patterns to look for.
+ * @param[out] matches For each pattern, the address of its match.
+ * @param[out] found For each pattern, whether it was found.
+ *
+ * @return The number of patterns found.
+ */
+size_t scan_findParallel(pid_t pid, const ProcessMap* regions, size_t regions_count, const ScanMultiPattern* multi, uintptr_t* matches, bool* found)
+{
+    for (size_t p = 0; p < multi->count; p++) {
+        found[p] = false;
+    }
+    if (multi->count == 0) {
+        return 0;
+    }
+
+    ScanJob job = {
+        .pid = pid,
+        .multi = multi,
+    };
+    size_t total_size;
+    job.items = split_regions(regions, regions_count, multi->max_length, &job.items_count, &total_size);
+    job.matches = malloc((job.items_count ? job.items_count : 1) * multi->count * sizeof(uintptr_t));
+    job.best_items = malloc(multi->count * sizeof(atomic_size_t));
+    if (!job.items || !job.matches || !job.best_items) {
+        free(job.items);
+        free(job.matches);
+        free(job.best_items);
+        return 0;
+    }
+    atomic_init(&job.next_item, 0);
+    for (size_t p = 0; p < multi->count; p++) {
+        atomic_init(&job.best_items[p], SIZE_MAX);
+    }
+
+    long threads_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads_count > SCAN_MAX_THREADS) {
+        threads_count = SCAN_MAX_THREADS;
+    }
+    if (threads_count < 1 || total_size < SCAN_PARALLEL_THRESHOLD) {
+        threads_count = 1;
+    }
+
+    // The calling thread works too, so one less thread has to be started
+    pthread_t threads[SCAN_MAX_THREADS];
+    long started = 0;
+    for (long i = 1; i < threads_count; i++) {
+        if (pthread_create(&threads[started], NULL, scan_worker, &job) == 0) {
+            started++;
+        }
+    }
+    scan_worker(&job);
+    for (long i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    size_t found_count = 0;
+    for (size_t p = 0; p < multi->count; p++) {
+        size_t best = atomic_load(&job.best_items[p]);
+        if (best != SIZE_MAX) {
+            matches[p] = job.matches[best * multi->count + p];
+            found[p] = true;
+            found_count++;
+        }
+    }
+    free(job.items);
+    free(job.matches);
+    free(job.best_items);
+    return found_count;
+}
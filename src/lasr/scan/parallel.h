@@ -0,0 +1,26 @@
+#pragma once
+
+#include "multi.h"
+#include "src/lasr/utils.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Regions bigger than this are split into several work items.
+ */
+#define SCAN_SLICE_SIZE (16 * 1024 * 1024)
+
+/**
+ * Scans with less memory than this to read are done on the calling thread only.
+ */
+#define SCAN_PARALLEL_THRESHOLD (32 * 1024 * 1024)
+
+/**
+ * The maximum number of threads used by a scan.
+ */
+#define SCAN_MAX_THREADS 16
+
+size_t scan_findParallel(pid_t pid, const ProcessMap* regions, size_t regions_count, const ScanMultiPattern* multi, uintptr_t* matches, bool* found);
@@ -0,0 +1,385 @@
+/** \file pattern.c
+ *
+ * Signature compilation and in-memory pattern matching.
+ *
+ * Instead of testing the pattern at every offset, the rarest fixed bytes of
+ * the signature are used as anchors: candidates are found by comparing many
+ * bytes at once against the anchors, and only those are verified against the
+ * full masked pattern.
+ */
+#include "pattern.h"
+
+#include "src/lasr/memory/arena.h"
+
+#include <ctype.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/**
+ * How common a byte is in executable code and data, higher is more common.
+ *
+ * Bytes not listed here are considered rare. The values only need to be
+ * roughly ordered, they're used to pick which bytes to look for first.
+ */
+static const uint8_t byte_frequency[256] = {
+    [0x00] = 255, [0xFF] = 200, [0x48] = 190, [0x8B] = 180, [0xCC] = 170,
+    [0x89] = 160, [0x24] = 150, [0x4C] = 140, [0x0F] = 130, [0x01] = 120,
+    [0xE8] = 110, [0x8D] = 110, [0x83] = 110, [0x90] = 100, [0x44] = 100,
+    [0x45] = 90, [0x85] = 90, [0xC0] = 90, [0x74] = 80, [0x75] = 80,
+    [0xC3] = 80, [0x41] = 80, [0x49] = 70, [0x08] = 70, [0x10] = 70,
+    [0x20] = 70, [0x04] = 60, [0x02] = 60, [0x40] = 60, [0x80] = 60,
+    [0x03] = 50, [0xFE] = 50, [0x33] = 50, [0xC7] = 50, [0x50] = 40,
+    [0xE9] = 40, [0xEB] = 40, [0x5C] = 40, [0x28] = 40, [0x30] = 40,
+};
+
+/**
+ * Picks the anchors of a pattern, the two rarest fixed bytes.
+ *
+ * The second anchor prefers a different byte value than the first one,
+ * so that it filters out more candidates.
+ *
+ * @param pattern The pattern to pick the anchors for.
+ */
+static void pick_anchors(ScanPattern* pattern)
+{
+    pattern->has_anchor = false;
+    int best_score = 0;
+    for (size_t i = 0; i < pattern->length; i++) {
+        if (!pattern->mask[i]) {
+            continue;
+        }
+        int score = byte_frequency[pattern->bytes[i]];
+        if (!pattern->has_anchor || score < best_score) {
+            pattern->anchor = i;
+            best_score = score;
+            pattern->has_anchor = true;
+        }
+    }
+    if (!pattern->has_anchor) {
+        return;
+    }
+
+    pattern->anchor2 = pattern->anchor;
+    best_score = 0;
+    for (size_t i = 0; i < pattern->length; i++) {
+        if (!pattern->mask[i] || i == pattern->anchor) {
+            continue;
+        }
+        int score = byte_frequency[pattern->bytes[i]];
+        if (pattern->bytes[i] == pattern->bytes[pattern->anchor]) {
+            score += 256;
+        }
+        if (pattern->anchor2 == pattern->anchor || score < best_score) {
+            pattern->anchor2 = i;
+            best_score = score;
+        }
+    }
+}
+
+/**
+ * Compiles an IDA-like signature into a pattern.
+ * Supports the '??' string to ignore certain bytes in the comparison.
+ * Half-byte masks are treated as full-byte masks (0? => ?? or ?F => ??).
+ *
+ * @param[in] signature A string containing the signature to convert.
+ * @param[out] out The compiled pattern, allocated from the LASR arena.
+ *
+ * @return True on success, false if the signature is empty or invalid.
+ */
+bool scan_compilePattern(const char* signature, ScanPattern* out)
+{
+    size_t capacity = strlen(signature) / 2 + 1;
+    out->bytes = arena_alloc(capacity);
+    out->mask = arena_alloc(capacity);
+    out->length = 0;
+    if (!out->bytes || !out->mask) {
+        scan_freePattern(out);
+        return false;
+    }
+
+    const char* cursor = signature;
+    while (*cursor) {
+        if (isspace((unsigned char)*cursor)) {
+            cursor++;
+            continue;
+        }
+        const char* token_end = cursor;
+        while (*token_end && !isspace((unsigned char)*token_end)) {
+            token_end++;
+        }
+
+        if (memchr(cursor, '?', token_end - cursor) != NULL) {
+            out->bytes[out->length] = 0;
+            out->mask[out->length] = 0x00;
+        } else {
+            char* parse_end;
+            unsigned long value = strtoul(cursor, &parse_end, 16);
+            if (parse_end != token_end || value > 0xFF) {
+                scan_freePattern(out);
+                return false;
+            }
+            out->bytes[out->length] = (uint8_t)value;
+            out->mask[out->length] = 0xFF;
+        }
+        out->length++;
+        cursor = token_end;
+    }
+
+    if (out->length == 0) {
+        scan_freePattern(out);
+        return false;
+    }
+
+    pick_anchors(out);
+    return true;
+}
+
+/**
+ * Forgets a compiled pattern.
+ *
+ * Its memory comes from the LASR arena, which frees it.
+ *
+ * @param pattern The pattern to forget.
+ */
+void scan_freePattern(ScanPattern* pattern)
+{
+    pattern->bytes = NULL;
+    pattern->mask = NULL;
+    pattern->length = 0;
+}
+
+/**
+ * Matches a pattern with an array of bytes.
+ *
+ * @param[in] pattern The pattern to test for.
+ * @param[in] data The data to compare the pattern against, at least `pattern->length` bytes long.
+ *
+ * @return True if the pattern matches the data, false otherwise
+ */
+bool scan_matchAt(const ScanPattern* pattern, const uint8_t* data)
+{
+    for (size_t i = 0; i < pattern->length; i++) {
+        if ((data[i] & pattern->mask[i]) != pattern->bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Finds the first match using memchr on the first anchor.
+ *
+ * @param pattern The pattern to look for.
+ * @param data The data to search in.
+ * @param size The size of the data.
+ *
+ * @return The offset of the first match, or SCAN_NOT_FOUND.
+ */
+static size_t find_scalar(const ScanPattern* pattern, const uint8_t* data, size_t size)
+{
+    if (size < pattern->length) {
+        return SCAN_NOT_FOUND;
+    }
+    if (!pattern->has_anchor) {
+        return 0;
+    }
+
+    const size_t last = size - pattern->length;
+    const uint8_t anchor_byte = pattern->bytes[pattern->anchor];
+    const uint8_t anchor2_byte = pattern->bytes[pattern->anchor2];
+    size_t i = 0;
+    while (i <= last) {
+        const uint8_t* hit = memchr(data + i + pattern->anchor, anchor_byte, last - i + 1);
+        if (!hit) {
+            break;
+        }
+        i = hit - data - pattern->anchor;
+        if (data[i + pattern->anchor2] == anchor2_byte && scan_matchAt(pattern, data + i)) {
+            return i;
+        }
+        i++;
+    }
+    return SCAN_NOT_FOUND;
+}
+
+#ifdef SCAN_X86
+/**
+ * Finds the first match comparing 16 candidates at a time against both anchors.
+ *
+ * @param pattern The pattern to look for.
+ * @param data The data to search in.
+ * @param size The size of the data.
+ *
+ * @return The offset of the first match, or SCAN_NOT_FOUND.
+ */
+__attribute__((target("sse2"))) static size_t find_sse2(const ScanPattern* pattern, const uint8_t* data, size_t size)
+{
+    if (size < pattern->length) {
+        return SCAN_NOT_FOUND;
+    }
+    if (!pattern->has_anchor) {
+        return 0;
+    }
+
+    const size_t positions = size - pattern->length + 1;
+    const __m128i first = _mm_set1_epi8((char)pattern->bytes[pattern->anchor]);
+    const __m128i second = _mm_set1_epi8((char)pattern->bytes[pattern->anchor2]);
+    size_t i = 0;
+    // The last byte loaded is at i + 15 + anchor, which stays inside the data
+    // as long as there are 16 candidate positions left
+    for (; i + 16 <= positions; i += 16) {
+        __m128i block1 = _mm_loadu_si128((const __m128i*)(data + i + pattern->anchor));
+        __m128i block2 = _mm_loadu_si128((const __m128i*)(data + i + pattern->anchor2));
+        unsigned int candidates = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block1, first), _mm_cmpeq_epi8(block2, second)));
+        while (candidates) {
+            unsigned int bit = __builtin_ctz(candidates);
+            if (scan_matchAt(pattern, data + i + bit)) {
+                return i + bit;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+
+    size_t tail = find_scalar(pattern, data + i, size - i);
+    return tail == SCAN_NOT_FOUND ? SCAN_NOT_FOUND : i + tail;
+}
+
+/**
+ * Finds the first match comparing 32 candidates at a time against both anchors.
+ *
+ * @param pattern The pattern to look for.
+ * @param data The data to search in.
+ * @param size The size of the data.
+ *
+ * @return The offset of the first match, or SCAN_NOT_FOUND.
+ */
+__attribute__((target("avx2"))) static size_t find_avx2(const ScanPattern* pattern, const uint8_t* data, size_t size)
+{
+    if (size < pattern->length) {
+        return SCAN_NOT_FOUND;
+    }
+    if (!pattern->has_anchor) {
+        return 0;
+    }
+
+    const size_t positions = size - pattern->length + 1;
+    const __m256i first = _mm256_set1_epi8((char)pattern->bytes[pattern->anchor]);
+    const __m256i second = _mm256_set1_epi8((char)pattern->bytes[pattern->anchor2]);
+    size_t i = 0;
+    for (; i + 32 <= positions; i += 32) {
+        __m256i block1 = _mm256_loadu_si256((const __m256i*)(data + i + pattern->anchor));
+        __m256i block2 = _mm256_loadu_si256((const __m256i*)(data + i + pattern->anchor2));
+        unsigned int candidates = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block1, first), _mm256_cmpeq_epi8(block2, second)));
+        while (candidates) {
+            unsigned int bit = __builtin_ctz(candidates);
+            if (scan_matchAt(pattern, data + i + bit)) {
+                return i + bit;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+
+    size_t tail = find_sse2(pattern, data + i, size - i);
+    return tail == SCAN_NOT_FOUND ? SCAN_NOT_FOUND : i + tail;
+}
+#endif
+
+/**
+ * Checks if the current CPU can run a backend.
+ *
+ * @param backend The backend to check.
+ *
+ * @return True if the backend can be used.
+ */
+bool scan_backendSupported(ScanBackend backend)
+{
+    switch (backend) {
+        case SCAN_BACKEND_SCALAR:
+            return true;
+#ifdef SCAN_X86
+        case SCAN_BACKEND_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case SCAN_BACKEND_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * Gets a printable name for a backend.
+ *
+ * @param backend The backend.
+ *
+ * @return The name of the backend.
+ */
+const char* scan_backendName(ScanBackend backend)
+{
+    switch (backend) {
+        case SCAN_BACKEND_SCALAR:
+            return "scalar";
+        case SCAN_BACKEND_SSE2:
+            return "sse2";
+        case SCAN_BACKEND_AVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+/**
+ * Finds the first match of a pattern using a specific backend.
+ *
+ * Falls back to the scalar backend if the requested one isn't supported.
+ *
+ * @param backend The backend to use.
+ * @param pattern The pattern to look for.
+ * @param data The data to search in.
+ * @param size The size of the data.
+ *
+ * @return The offset of the first match, or SCAN_NOT_FOUND.
+ */
+size_t scan_findWith(ScanBackend backend, const ScanPattern* pattern, const uint8_t* data, size_t size)
+{
+#ifdef SCAN_X86
+    if (backend == SCAN_BACKEND_AVX2 && scan_backendSupported(backend)) {
+        return find_avx2(pattern, data, size);
+    }
+    if (backend == SCAN_BACKEND_SSE2 && scan_backendSupported(backend)) {
+        return find_sse2(pattern, data, size);
+    }
+#endif
+    return find_scalar(pattern, data, size);
+}
+
+/**
+ * Finds the first match of a pattern with the fastest backend the CPU supports.
+ *
+ * @param pattern The pattern to look for.
+ * @param data The data to search in.
+ * @param size The size of the data.
+ *
+ * @return The offset of the first match, or SCAN_NOT_FOUND.
+ */
+size_t scan_find(const ScanPattern* pattern, const uint8_t* data, size_t size)
+{
+    // Scans can run on several threads, they would all pick the same backend
+    static atomic_int best = -1;
+    int backend = atomic_load_explicit(&best, memory_order_relaxed);
+    if (backend < 0) {
+        backend = SCAN_BACKEND_SCALAR;
+        if (scan_backendSupported(SCAN_BACKEND_AVX2)) {
+            backend = SCAN_BACKEND_AVX2;
+        } else if (scan_backendSupported(SCAN_BACKEND_SSE2)) {
+            backend = SCAN_BACKEND_SSE2;
+        }
+        atomic_store_explicit(&best, backend, memory_order_relaxed);
+    }
+    return scan_findWith((ScanBackend)backend, pattern, data, size);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Returned by the find functions when there is no match.
+ */
+#define SCAN_NOT_FOUND SIZE_MAX
+
+/**
+ * The implementations available to look for candidates.
+ */
+typedef enum ScanBackend {
+    SCAN_BACKEND_SCALAR, /*!< Plain C, memchr-based */
+    SCAN_BACKEND_SSE2, /*!< 16 bytes at a time */
+    SCAN_BACKEND_AVX2, /*!< 32 bytes at a time */
+} ScanBackend;
+
+/**
+ * A compiled signature.
+ *
+ * Candidates are found by looking for the two rarest fixed bytes of the
+ * signature (the anchors), then the whole masked pattern is verified.
+ */
+typedef struct ScanPattern {
+    uint8_t* bytes; /*!< The bytes to match, zero where the mask is zero */
+    uint8_t* mask; /*!< 0xFF for bytes that must match, 0x00 for wildcards */
+    size_t length; /*!< The length of the pattern */
+    size_t anchor; /*!< Index of the rarest fixed byte */
+    size_t anchor2; /*!< Index of the second rarest fixed byte, equal to `anchor` if there is only one */
+    bool has_anchor; /*!< False if the pattern is only made of wildcards */
+} ScanPattern;
+
+bool scan_compilePattern(const char* signature, ScanPattern* out);
+void scan_freePattern(ScanPattern* pattern);
+bool scan_matchAt(const ScanPattern* pattern, const uint8_t* data);
+size_t scan_find(const ScanPattern* pattern, const uint8_t* data, size_t size);
+size_t scan_findWith(ScanBackend backend, const ScanPattern* pattern, const uint8_t* data, size_t size);
+bool scan_backendSupported(ScanBackend backend);
+const char* scan_backendName(ScanBackend backend);
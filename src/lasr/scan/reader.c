@@ -0,0 +1,108 @@
+/** \file reader.c
+ *
+ * Streaming of the target process memory through a fixed-size buffer.
+ *
+ * Regions are read chunk by chunk, keeping the last `overlap` bytes of a
+ * chunk at the beginning of the next one so that patterns crossing a chunk
+ * boundary are still found. Pages that can't be read are skipped, without
+ * giving up on the rest of the region.
+ */
+#include "reader.h"
+
+#include "src/lasr/memory/read.h"
+#include "src/lasr/utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Prepares a reader for a process.
+ *
+ * @param reader The reader to initialize.
+ * @param pid The process to read from.
+ * @param overlap How many bytes to carry over between chunks, usually the pattern length minus one.
+ *
+ * @return True on success, false if the buffer could not be allocated.
+ */
+bool scan_initReader(ScanReader* reader, pid_t pid, size_t overlap)
+{
+    reader->pid = pid;
+    reader->overlap = overlap;
+    reader->capacity = SCAN_CHUNK_SIZE;
+    // Make sure each chunk still brings in a reasonable amount of new bytes
+    if (reader->capacity < overlap * 2) {
+        reader->capacity = overlap * 2;
+    }
+    reader->buffer = malloc(reader->capacity);
+    return reader->buffer != NULL;
+}
+
+/**
+ * Frees the buffer of a reader.
+ *
+ * @param reader The reader to free.
+ */
+void scan_freeReader(ScanReader* reader)
+{
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->capacity = 0;
+}
+
+/**
+ * Streams a memory region of the target process through the reader buffer.
+ *
+ * process_vm_readv stops at the first page it can't read, so a short read
+ * is followed by a read that faults: in that case only the faulty page is
+ * skipped and the overlap is dropped, since the bytes around the hole are
+ * not contiguous. The region must be readable, an unreadable one would
+ * cost a syscall per page.
+ *
+ * @param reader The reader to use.
+ * @param start The start address of the region.
+ * @param end The end address of the region (exclusive).
+ * @param callback The function to call for each chunk.
+ * @param userdata Passed as-is to the callback.
+ *
+ * @return True if the callback asked to stop, false if the whole region was read.
+ */
+bool scan_readRegion(ScanReader* reader, uintptr_t start, uintptr_t end, ScanChunkCallback callback, void* userdata)
+{
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t position = start;
+    size_t carry = 0;
+
+    while (position < end) {
+        size_t wanted = reader->capacity - carry;
+        if (wanted > end - position) {
+            wanted = end - position;
+        }
+
+        struct iovec local_iov = { reader->buffer + carry, wanted };
+        struct iovec remote_iov = { (void*)position, wanted };
+        ssize_t n_read = memory_readv(reader->pid, &local_iov, 1, &remote_iov, 1);
+
+        if (n_read <= 0) {
+            if (n_read == -1 && errno != EFAULT) {
+                // The process is gone or can't be read at all
+                return false;
+            }
+            // Skip the unreadable page
+            position = (position & ~(page_size - 1)) + page_size;
+            carry = 0;
+            continue;
+        }
+
+        size_t total = carry + n_read;
+        if (callback(userdata, reader->buffer, total, position - carry)) {
+            return true;
+        }
+        position += n_read;
+
+        carry = reader->overlap < total ? reader->overlap : total;
+        memmove(reader->buffer, reader->buffer + total - carry, carry);
+    }
+    return false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * The default size of the buffer used to stream memory regions.
+ */
+#define SCAN_CHUNK_SIZE (1024 * 1024)
+
+/**
+ * Called for every chunk of memory streamed by scan_readRegion.
+ *
+ * @param userdata The pointer passed to scan_readRegion.
+ * @param data The bytes read, starting with the overlap kept from the previous chunk.
+ * @param size The number of bytes in `data`.
+ * @param address The address `data` was read from in the target process.
+ *
+ * @return True to stop reading, false to continue.
+ */
+typedef bool (*ScanChunkCallback)(void* userdata, const uint8_t* data, size_t size, uintptr_t address);
+
+/**
+ * A reusable buffer to stream memory regions through.
+ */
+typedef struct ScanReader {
+    pid_t pid; /*!< The process to read from */
+    uint8_t* buffer; /*!< The chunk buffer */
+    size_t capacity; /*!< The size of `buffer` */
+    size_t overlap; /*!< Bytes carried over between contiguous chunks */
+} ScanReader;
+
+bool scan_initReader(ScanReader* reader, pid_t pid, size_t overlap);
+void scan_freeReader(ScanReader* reader);
+bool scan_readRegion(ScanReader* reader, uintptr_t start, uintptr_t end, ScanChunkCallback callback, void* userdata);
@@ -0,0 +1,260 @@
+/** \file scheduler.c
+ *
+ * Tick scheduler of the auto splitter loop.
+ *
+ * A periodic timerfd expires on every deadline, and is polled along with the
+ * pidfd of the game so an exit interrupts the wait. The number of expirations
+ * read from the timer tells how many deadlines passed, so overruns are counted
+ * without any extra bookkeeping. Without timerfd, the thread sleeps with
+ * clock_nanosleep until the absolute deadline instead, or polls the file
+ * descriptor to watch with the time left as timeout.
+ */
+#define _GNU_SOURCE // For pthread_setschedparam and ppoll
+
+#include "scheduler.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define NSEC_PER_SEC 1000000000L
+
+Scheduler tick_scheduler = { .timerfd = -1 };
+
+/**
+ * Adds nanoseconds to a time.
+ */
+static struct timespec timespec_add(struct timespec time, long long ns)
+{
+    long long total = time.tv_nsec + ns;
+    time.tv_sec += total / NSEC_PER_SEC;
+    time.tv_nsec = total % NSEC_PER_SEC;
+    return time;
+}
+
+/**
+ * Gets the difference between two times, in nanoseconds.
+ */
+static long long timespec_diff(struct timespec a, struct timespec b)
+{
+    return (long long)(a.tv_sec - b.tv_sec) * NSEC_PER_SEC + (a.tv_nsec - b.tv_nsec);
+}
+
+/**
+ * Makes the current thread wake up as close to its deadlines as possible,
+ * remembering its previous settings.
+ *
+ * The timer slack is lowered to 1ns, and the thread is switched to the
+ * SCHED_FIFO real-time policy if it is allowed to (CAP_SYS_NICE or RLIMIT_RTPRIO).
+ */
+static void enable_realtime(Scheduler* scheduler)
+{
+    scheduler->old_timerslack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+
+    struct sched_param param;
+    pthread_getschedparam(pthread_self(), &scheduler->old_policy, &param);
+    scheduler->old_priority = param.sched_priority;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error) {
+        printf("[scheduler] Cannot use real-time scheduling: %s\n", strerror(error));
+    }
+    scheduler->realtime = true;
+}
+
+/**
+ * Restores the thread settings changed by enable_realtime.
+ */
+static void disable_realtime(Scheduler* scheduler)
+{
+    if (!scheduler->realtime) {
+        return;
+    }
+    prctl(PR_SET_TIMERSLACK, scheduler->old_timerslack, 0, 0, 0);
+    struct sched_param param = { .sched_priority = scheduler->old_priority };
+    pthread_setschedparam(pthread_self(), scheduler->old_policy, &param);
+    scheduler->realtime = false;
+}
+
+/**
+ * Starts scheduling ticks, the first one being due one period from now.
+ *
+ * @param scheduler The scheduler.
+ * @param rate The number of ticks per second.
+ * @param realtime Whether to lower the timer slack and use real-time scheduling.
+ */
+void scheduler_init(Scheduler* scheduler, int rate, bool realtime)
+{
+    *scheduler = (Scheduler) {
+        .period_ns = NSEC_PER_SEC / (rate > 0 ? rate : 1),
+        .timerfd = -1,
+    };
+    if (realtime) {
+        enable_realtime(scheduler);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &scheduler->start);
+    scheduler->start = timespec_add(scheduler->start, scheduler->period_ns);
+
+    scheduler->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (scheduler->timerfd >= 0) {
+        struct itimerspec spec = {
+            .it_value = scheduler->start,
+            .it_interval = { .tv_sec = scheduler->period_ns / NSEC_PER_SEC, .tv_nsec = scheduler->period_ns % NSEC_PER_SEC },
+        };
+        if (timerfd_settime(scheduler->timerfd, TFD_TIMER_ABSTIME, &spec, NULL) != 0) {
+            close(scheduler->timerfd);
+            scheduler->timerfd = -1;
+        }
+    }
+}
+
+/**
+ * Stops scheduling ticks, restoring the thread settings.
+ *
+ * The statistics are kept until the next scheduler_init.
+ *
+ * @param scheduler The scheduler.
+ */
+void scheduler_free(Scheduler* scheduler)
+{
+    if (scheduler->timerfd >= 0) {
+        close(scheduler->timerfd);
+        scheduler->timerfd = -1;
+    }
+    disable_realtime(scheduler);
+}
+
+/**
+ * Records how late a tick started.
+ */
+static void record_jitter(Scheduler* scheduler, long long late_ns)
+{
+    if (late_ns < 0) {
+        late_ns = 0;
+    }
+    if (late_ns > scheduler->max_jitter_ns) {
+        scheduler->max_jitter_ns = late_ns;
+    }
+    size_t bucket = 0;
+    for (long long us = late_ns / 1000; us > 0 && bucket < SCHEDULER_JITTER_BUCKETS - 1; us >>= 1) {
+        bucket++;
+    }
+    scheduler->jitter[bucket]++;
+    scheduler->ticks++;
+}
+
+/**
+ * Waits for the next tick deadline without timerfd, polling `watch_fd` until
+ * the deadline or sleeping until it if there's nothing to watch.
+ *
+ * @param scheduler The scheduler.
+ * @param watch_fd A file descriptor interrupting the wait when it becomes readable, -1 for none.
+ *
+ * @return True if the wait was interrupted by `watch_fd`.
+ */
+static bool wait_sleeping(Scheduler* scheduler, int watch_fd)
+{
+    struct timespec deadline = timespec_add(scheduler->start, (long long)scheduler->deadlines * scheduler->period_ns);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_diff(now, deadline) >= scheduler->period_ns) {
+        // Skip to the latest missed deadline
+        uint64_t missed = timespec_diff(now, deadline) / scheduler->period_ns;
+        scheduler->overruns += missed;
+        scheduler->deadlines += missed;
+        deadline = timespec_add(scheduler->start, (long long)scheduler->deadlines * scheduler->period_ns);
+    }
+
+    struct pollfd fd = { .fd = watch_fd, .events = POLLIN };
+    long long left;
+    while ((left = timespec_diff(deadline, now)) > 0) {
+        if (watch_fd < 0) {
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        } else {
+            struct timespec timeout = { .tv_sec = left / NSEC_PER_SEC, .tv_nsec = left % NSEC_PER_SEC };
+            int ready = ppoll(&fd, 1, &timeout, NULL);
+            if (ready > 0) {
+                return true;
+            }
+            if (ready < 0 && errno != EINTR) {
+                // Keep the ticks going without watching
+                watch_fd = -1;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+    scheduler->deadlines++;
+    record_jitter(scheduler, timespec_diff(now, deadline));
+    return false;
+}
+
+/**
+ * Waits for the next tick deadline.
+ *
+ * If the previous tick took so long that deadlines were missed, they are
+ * counted as overruns and the next tick starts right away, on the latest
+ * missed deadline.
+ *
+ * @param scheduler The scheduler.
+ * @param watch_fd A file descriptor interrupting the wait when it becomes readable, -1 for none.
+ *
+ * @return True if the wait was interrupted by `watch_fd`.
+ */
+bool scheduler_wait(Scheduler* scheduler, int watch_fd)
+{
+    if (scheduler->timerfd < 0) {
+        return wait_sleeping(scheduler, watch_fd);
+    }
+
+    struct pollfd fds[2] = {
+        { .fd = scheduler->timerfd, .events = POLLIN },
+        { .fd = watch_fd, .events = POLLIN },
+    };
+    for (;;) {
+        if (poll(fds, watch_fd >= 0 ? 2 : 1, -1) < 0 && errno != EINTR) {
+            // Waiting on the timer is broken, sleep until the deadlines instead
+            printf("[scheduler] Cannot wait for the timer: %s\n", strerror(errno));
+            close(scheduler->timerfd);
+            scheduler->timerfd = -1;
+            return wait_sleeping(scheduler, watch_fd);
+        }
+        if (watch_fd >= 0 && fds[1].revents) {
+            return true;
+        }
+        uint64_t expirations;
+        if (fds[0].revents && read(scheduler->timerfd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            scheduler->deadlines += expirations;
+            scheduler->overruns += expirations - 1;
+            break;
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct timespec deadline = timespec_add(scheduler->start, (long long)(scheduler->deadlines - 1) * scheduler->period_ns);
+    record_jitter(scheduler, timespec_diff(now, deadline));
+    return false;
+}
+
+/**
+ * Gets the time left until the next tick deadline.
+ *
+ * @param scheduler The scheduler.
+ *
+ * @return The time left, in nanoseconds, negative if the deadline already passed.
+ */
+long long scheduler_remaining(const Scheduler* scheduler)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct timespec deadline = timespec_add(scheduler->start, (long long)scheduler->deadlines * scheduler->period_ns);
+    return timespec_diff(deadline, now);
+}
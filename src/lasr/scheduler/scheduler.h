@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * The number of buckets of the jitter histogram.
+ *
+ * Bucket `i` counts the ticks that started less than 2^i microseconds after
+ * their deadline, the last one counts all the later ticks.
+ */
+#define SCHEDULER_JITTER_BUCKETS 16
+
+/**
+ * Runs the auto splitter ticks at a fixed rate, on absolute deadlines.
+ *
+ * Deadlines are multiples of the period since the start, so the time spent
+ * in a tick never shifts the following ones.
+ */
+typedef struct Scheduler {
+    long period_ns; /*!< The time between two ticks */
+    struct timespec start; /*!< The deadline of the first tick */
+    int timerfd; /*!< Periodic timer expiring on every deadline, -1 to use clock_nanosleep instead */
+    uint64_t deadlines; /*!< The number of deadlines passed since the start */
+    uint64_t ticks; /*!< The number of ticks run */
+    uint64_t overruns; /*!< The number of deadlines missed because a tick took too long */
+    uint64_t jitter[SCHEDULER_JITTER_BUCKETS]; /*!< Histogram of how late the ticks started */
+    long max_jitter_ns; /*!< The latest a tick started after its deadline */
+    bool realtime; /*!< True if the thread settings were changed and have to be restored */
+    int old_policy; /*!< The scheduling policy before switching to SCHED_FIFO */
+    int old_priority; /*!< The scheduling priority before switching to SCHED_FIFO */
+    int old_timerslack; /*!< The timer slack before lowering it */
+} Scheduler;
+
+extern Scheduler tick_scheduler;
+
+void scheduler_init(Scheduler* scheduler, int rate, bool realtime);
+void scheduler_free(Scheduler* scheduler);
+bool scheduler_wait(Scheduler* scheduler, int watch_fd);
+long long scheduler_remaining(const Scheduler* scheduler);
@@ -4,7 +4,7 @@
 #include <glib.h>
 #include <stdio.h>
 
-game_process process;
+game_process process = { .pidfd = -1 };
 
 /**
  * Gets the base address of a module.
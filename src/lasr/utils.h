@@ -22,6 +22,8 @@ typedef struct game_process {
     unsigned int pid; /*!< The PID of the process */
     uintptr_t base_address; /*!< The detected base address of the process */
     uintptr_t dll_address; /*!< The detected base address of the last requested module */
+    int pidfd; /*!< A pidfd referring to the process, -1 if unavailable */
+    uint8_t pointer_size; /*!< The size of the game pointers (4 or 8 bytes), 0 if unknown */
 } game_process;
 extern game_process process;
 
@@ -29,6 +31,7 @@ typedef struct ProcessMap {
     uintptr_t start;
     uintptr_t end;
     uintptr_t size;
+    char perms[5];
     char name[PATH_MAX];
 } ProcessMap;
 
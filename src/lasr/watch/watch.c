@@ -0,0 +1,356 @@
+/** \file watch.c
+ *
+ * Values of the game memory watched by the auto splitter.
+ *
+ * Scripts register their values once with `watch`, then every tick refreshes
+ * all of them with a single read plan before the callbacks run. Every watcher
+ * keeps its current and previous value in two buffers that are swapped on
+ * each refresh, so nothing is copied or allocated per tick.
+ *
+ * The values are reached through the `watchers.current`, `watchers.old` and
+ * `watchers.changed` views: empty tables whose __index reads the buffers.
+ */
+#include "watch.h"
+
+#include "src/lasr/maps/maps.h"
+#include "src/lasr/utils.h"
+
+#include <lauxlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * What a view shows of the watchers.
+ */
+typedef enum WatchView {
+    WATCH_VIEW_CURRENT, /*!< The values read on this tick */
+    WATCH_VIEW_OLD, /*!< The values read on the previous tick */
+    WATCH_VIEW_CHANGED, /*!< Whether the values differ between the previous tick and this one */
+} WatchView;
+
+/**
+ * The watchers of the running script.
+ *
+ * LASR runs on a single thread, so there's no need to guard this.
+ */
+static struct {
+    Watcher* items;
+    ReadChain* chains; /*!< The chains of a refresh, one per watcher at most */
+    size_t* owners; /*!< The watcher of each chain */
+    size_t count;
+    size_t capacity;
+    int current; /*!< The index of the current values in `Watcher.values` */
+    int index_ref; /*!< Registry reference to the table mapping names to watcher indexes */
+} watchers = { .index_ref = LUA_NOREF };
+
+/**
+ * Frees the fields of a watcher.
+ */
+static void watcher_free(Watcher* watcher)
+{
+    free(watcher->name);
+    free(watcher->module);
+    free(watcher->offsets);
+    free(watcher->values[0]);
+}
+
+/**
+ * Compares the current and old values of a watcher.
+ *
+ * @return True if the value appeared, disappeared or differs from the previous tick.
+ */
+static bool watcher_changed(const Watcher* watcher)
+{
+    int current = watchers.current;
+    int old = !current;
+    if (watcher->valid[current] != watcher->valid[old]) {
+        return true;
+    }
+    if (!watcher->valid[current]) {
+        return false;
+    }
+    if (watcher->type.tag == READ_TYPE_STRING) {
+        // The bytes after the terminator aren't part of the value
+        return strncmp((const char*)watcher->values[current], (const char*)watcher->values[old], watcher->type.size) != 0;
+    }
+    if (watcher->type.tag == READ_TYPE_WSTRING) {
+        const uint16_t* current_units = (const uint16_t*)watcher->values[current];
+        const uint16_t* old_units = (const uint16_t*)watcher->values[old];
+        for (size_t i = 0; i < watcher->type.size / sizeof(uint16_t); i++) {
+            if (current_units[i] != old_units[i]) {
+                return true;
+            }
+            if (current_units[i] == 0) {
+                break;
+            }
+        }
+        return false;
+    }
+    return memcmp(watcher->values[current], watcher->values[old], watcher->type.size) != 0;
+}
+
+/**
+ * The __index metamethod of the views.
+ *
+ * Upvalue 1 is the name to index table, upvalue 2 the WatchView.
+ *
+ * @param L The Lua state.
+ *
+ * @return Always 1: the value, or nil for unknown names and failed reads.
+ */
+static int view_index(lua_State* L)
+{
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    if (!lua_isnumber(L, -1)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    const Watcher* watcher = &watchers.items[lua_tointeger(L, -1)];
+
+    int values = watchers.current;
+    switch (lua_tointeger(L, lua_upvalueindex(2))) {
+        case WATCH_VIEW_CHANGED:
+            lua_pushboolean(L, watcher_changed(watcher));
+            return 1;
+        case WATCH_VIEW_OLD:
+            values = !values;
+            break;
+    }
+    if (watcher->valid[values]) {
+        readplan_pushValue(L, &watcher->type, watcher->values[values]);
+    } else {
+        lua_pushnil(L);
+    }
+    return 1;
+}
+
+/**
+ * The __newindex metamethod of the views, which are read-only.
+ *
+ * @param L The Lua state.
+ *
+ * @return Never returns.
+ */
+static int view_newindex(lua_State* L)
+{
+    return luaL_error(L, "watchers are read-only, register them with watch()");
+}
+
+/**
+ * Pushes a view of the watchers.
+ *
+ * @param L The Lua state.
+ * @param view What the view shows.
+ */
+static void push_view(lua_State* L, WatchView view)
+{
+    lua_newtable(L);
+    lua_createtable(L, 0, 3);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, watchers.index_ref);
+    lua_pushinteger(L, view);
+    lua_pushcclosure(L, view_index, 2);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, view_newindex);
+    lua_setfield(L, -2, "__newindex");
+    // Hide the metatable from scripts
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "__metatable");
+    lua_setmetatable(L, -2);
+}
+
+/**
+ * Removes all the watchers.
+ *
+ * @param L The Lua state the watchers were created in.
+ */
+void watch_clear(lua_State* L)
+{
+    luaL_unref(L, LUA_REGISTRYINDEX, watchers.index_ref);
+    for (size_t i = 0; i < watchers.count; i++) {
+        watcher_free(&watchers.items[i]);
+    }
+    free(watchers.items);
+    free(watchers.chains);
+    free(watchers.owners);
+    watchers.items = NULL;
+    watchers.chains = NULL;
+    watchers.owners = NULL;
+    watchers.count = 0;
+    watchers.capacity = 0;
+    watchers.current = 0;
+    watchers.index_ref = LUA_NOREF;
+}
+
+/**
+ * Removes the watchers of the previous script and creates the `watchers` global.
+ *
+ * @param L The Lua state.
+ */
+void watch_open(lua_State* L)
+{
+    watch_clear(L);
+    lua_newtable(L);
+    watchers.index_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    lua_createtable(L, 0, 3);
+    push_view(L, WATCH_VIEW_CURRENT);
+    lua_setfield(L, -2, "current");
+    push_view(L, WATCH_VIEW_OLD);
+    lua_setfield(L, -2, "old");
+    push_view(L, WATCH_VIEW_CHANGED);
+    lua_setfield(L, -2, "changed");
+    lua_setglobal(L, "watchers");
+}
+
+/**
+ * Makes sure there's room for one more watcher.
+ *
+ * @return True on success, false if the allocation failed.
+ */
+static bool ensure_capacity(void)
+{
+    if (watchers.count < watchers.capacity) {
+        return true;
+    }
+    size_t capacity = watchers.capacity ? watchers.capacity * 2 : 16;
+    Watcher* items = realloc(watchers.items, capacity * sizeof(Watcher));
+    if (items) {
+        watchers.items = items;
+    }
+    ReadChain* chains = realloc(watchers.chains, capacity * sizeof(ReadChain));
+    if (chains) {
+        watchers.chains = chains;
+    }
+    size_t* owners = realloc(watchers.owners, capacity * sizeof(size_t));
+    if (owners) {
+        watchers.owners = owners;
+    }
+    if (!items || !chains || !owners) {
+        return false;
+    }
+    watchers.capacity = capacity;
+    return true;
+}
+
+/**
+ * Registers a watcher, replacing the one with the same name if any.
+ *
+ * The value is first read on the next refresh.
+ *
+ * @param L The Lua state.
+ * @param name The name of the watcher in the views.
+ * @param type The type of the value.
+ * @param module The module name, NULL to use the main process.
+ * @param base_offset The offset to add to the module base address.
+ * @param offsets The pointer offsets, copied.
+ * @param offsets_count The number of pointer offsets.
+ *
+ * @return True on success, false if the allocation failed.
+ */
+bool watch_add(lua_State* L, const char* name, ReadType type, const char* module, int64_t base_offset, const int64_t* offsets, int offsets_count)
+{
+    size_t value_size = (type.size + 7) & ~(size_t)7;
+    Watcher watcher = {
+        .name = strdup(name),
+        .type = type,
+        .module = module ? strdup(module) : NULL,
+        .base_offset = base_offset,
+        .offsets_count = offsets_count,
+        .offsets = malloc(offsets_count * sizeof(int64_t) + 1),
+        .values = { malloc(value_size * 2) },
+    };
+    if (!watcher.name || (module && !watcher.module) || !watcher.offsets || !watcher.values[0]) {
+        watcher_free(&watcher);
+        return false;
+    }
+    memcpy(watcher.offsets, offsets, offsets_count * sizeof(int64_t));
+    watcher.values[1] = watcher.values[0] + value_size;
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, watchers.index_ref);
+    lua_getfield(L, -1, name);
+    if (lua_isnumber(L, -1)) {
+        Watcher* replaced = &watchers.items[lua_tointeger(L, -1)];
+        watcher_free(replaced);
+        *replaced = watcher;
+        lua_pop(L, 2); // Remove the index and the table from the stack
+        return true;
+    }
+    lua_pop(L, 1); // Remove nil from the stack
+
+    if (!ensure_capacity()) {
+        watcher_free(&watcher);
+        lua_pop(L, 1); // Remove the table from the stack
+        return false;
+    }
+    lua_pushinteger(L, watchers.count);
+    lua_setfield(L, -2, name);
+    lua_pop(L, 1); // Remove the table from the stack
+    watchers.items[watchers.count++] = watcher;
+    return true;
+}
+
+/**
+ * Resolves the base address of the module used by a watcher.
+ *
+ * @param watcher The watcher.
+ *
+ * @return The base address, or 0 if the module could not be found.
+ */
+static uintptr_t watcher_base(Watcher* watcher)
+{
+    if (!watcher->module) {
+        return process.base_address;
+    }
+    if (watcher->base == 0 || watcher->generation != maps_getGeneration()) {
+        watcher->base = find_base_address(watcher->module);
+        // Resolving can rebuild the maps cache, take the generation afterwards
+        watcher->generation = maps_getGeneration();
+    }
+    return watcher->base;
+}
+
+/**
+ * Reads all the watchers, their current values becoming the old ones.
+ *
+ * Called at the start of every tick.
+ */
+void watch_refresh(void)
+{
+    if (!watchers.count) {
+        return;
+    }
+    int current = watchers.current = !watchers.current;
+
+    size_t queued = 0;
+    for (size_t i = 0; i < watchers.count; i++) {
+        Watcher* watcher = &watchers.items[i];
+        watcher->valid[current] = false;
+        uintptr_t base = watcher_base(watcher);
+        if (base == 0) {
+            continue;
+        }
+        watchers.chains[queued] = (ReadChain) {
+            .address = base + watcher->base_offset,
+            .offsets = watcher->offsets,
+            .offsets_count = watcher->offsets_count,
+            .type = watcher->type,
+            .value = watcher->values[current],
+        };
+        watchers.owners[queued++] = i;
+    }
+
+    readplan_execute(watchers.chains, queued);
+
+    for (size_t q = 0; q < queued; q++) {
+        Watcher* watcher = &watchers.items[watchers.owners[q]];
+        if (watchers.chains[q].error != 0) {
+            // The module might have moved, resolve it again on the next refresh
+            watcher->base = 0;
+            handle_memory_error(watchers.chains[q].error);
+            continue;
+        }
+        watcher->valid[current] = true;
+    }
+}
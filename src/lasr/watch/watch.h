@@ -0,0 +1,28 @@
+#pragma once
+
+#include "src/lasr/memory/read_plan.h"
+
+#include <lua.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * A named value of the game memory, read on every tick.
+ */
+typedef struct Watcher {
+    char* name; /*!< The name of the watcher in the views */
+    ReadType type; /*!< The type of the value */
+    char* module; /*!< The module name, NULL to use the main process */
+    int64_t base_offset; /*!< The offset to add to the module base address */
+    uintptr_t base; /*!< The cached module base address, 0 if it has to be resolved */
+    unsigned int generation; /*!< The maps generation `base` was resolved in */
+    int offsets_count; /*!< The number of pointer offsets */
+    int64_t* offsets; /*!< The pointer offsets */
+    uint8_t* values[2]; /*!< The current and old values, swapped on every refresh */
+    bool valid[2]; /*!< Whether the matching value was read successfully */
+} Watcher;
+
+void watch_open(lua_State* L);
+void watch_clear(lua_State* L);
+bool watch_add(lua_State* L, const char* name, ReadType type, const char* module, int64_t base_offset, const int64_t* offsets, int offsets_count);
+void watch_refresh(void);
@@ -2,6 +2,7 @@
 #include "gui/timer.h"
 #include "keybinds/keybinds_callbacks.h"
 #include "lasr/auto-splitter.h"
+#include "lasr/profiler/profiler.h"
 #include "server.h"
 #include "settings/utils.h"
 #include "shared.h"
@@ -59,6 +60,13 @@ void handle_ctl_command(CTLCommand command)
         case CTL_CMD_EXIT:
             exit(0);
             break;
+        case CTL_CMD_DUMP_PROFILE:
+            profiler_dump(stdout);
+            fflush(stdout);
+            break;
+        case CTL_CMD_TOGGLE_PROFILER:
+            profiler_overlay_visible = !profiler_overlay_visible;
+            break;
         default:
             printf("Unknown CTL command: %d\n", command);
             break;
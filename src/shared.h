@@ -17,6 +17,8 @@ typedef enum CTLCommand {
     CTL_CMD_UNSPLIT, /*!< Undo split */
     CTL_CMD_SKIP, /*!< Skip split */
     CTL_CMD_EXIT, /*!< Exit */
+    CTL_CMD_DUMP_PROFILE, /*!< Print the auto splitter profile */
+    CTL_CMD_TOGGLE_PROFILER, /*!< Show or hide the auto splitter profiler overlay */
 } CTLCommand;
 
 /**